@@ -0,0 +1,150 @@
+#include "game.h"
+#include "trace.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * The positions searched, as the moves that lead to them: x,y from 0, X first.
+ */
+static const struct
+{
+	const char *name;
+	const char *moves;
+} Suite[] = {
+	{"opening-6", "5,6 9,6 9,9 10,6 8,6 11,6"},
+	{"opening-10", "6,9 8,5 7,7 9,5 7,5 7,6 6,7 9,4 6,8 6,6"},
+	{"middle-12", "7,8 9,5 7,9 7,7 8,6 9,7 7,10 9,6 9,8 8,7 10,7 8,9"},
+	{"middle-14", "5,8 9,5 7,5 8,6 6,8 11,3 10,4 8,8 4,8 3,8 5,7 8,4 5,6 5,9"},
+	{"middle-16", "8,8 9,7 7,6 9,8 9,9 7,7 8,7 8,6 8,10 9,5 8,9 8,11 6,8 6,4 10,8 10,4"},
+	{"attack-16", "8,8 8,5 9,9 7,7 7,9 5,9 9,7 6,10 9,8 9,6 9,11 9,10 11,5 10,6 6,8 8,10"},
+	{"attack-18", "6,9 9,6 7,9 9,9 9,7 8,8 7,7 10,10 7,8 11,11 12,12 7,10 8,7 10,7 6,5 10,8 7,6 7,5"},
+	{"late-26", "8,6 5,5 6,7 4,5 6,5 6,6 7,7 4,4 9,5 6,8 5,7 4,7 4,6 3,5 8,5 8,7 7,6 3,3 2,2 1,5 2,5 5,8 10,3 9,4 11,3 10,4"},
+};
+
+/**
+ * The total nodes per second recorded in a previous report, or a negative number if there is none.
+ */
+static double baselineNodesPerSecond(const char *path)
+{
+	std::ifstream file(path);
+	std::stringstream contents;
+	contents << file.rdbuf();
+
+	std::string report = contents.str();
+	size_t total = report.find("\"total\"");
+	size_t nps = (total == std::string::npos) ? std::string::npos : report.find("\"nps\":", total);
+
+	return (nps == std::string::npos) ? -1 : std::atof(report.c_str() + nps + 6);
+}
+
+/**
+ * Headless benchmark: search every position of the suite by iterative deepening, as the main search of
+ * autoMove does at a fixed depth, and report the move, nodes, time to each depth, nodes per second and
+ * the statistics of the search as JSON. The threat and proof-number searches autoMove runs first, and
+ * its helper threads, are left out, so that only the alpha-beta search is measured.
+ * Given a previous report with -b, fail if the total nodes per second dropped by more than -t percent.
+ *
+ * Usage: woo-bench [-d depth] [-m megabytes] [-b baseline] [-t percent]
+ */
+int main(int argc, char **argv)
+{
+	int depth = 6;
+	size_t megabytes = 16;
+	const char *baseline = nullptr;
+	double tolerance = 10;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+			depth = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+			megabytes = std::strtoul(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+			baseline = argv[++i];
+		else if (std::strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			tolerance = std::atof(argv[++i]);
+		else
+		{
+			std::cerr << "usage: woo-bench [-d depth] [-m megabytes] [-b baseline] [-t percent]" << std::endl;
+			return 2;
+		}
+	}
+
+	if (depth < 1 || depth >= GameState::MaxPly)
+	{
+		std::cerr << "woo-bench: depth must be from 1 to " << GameState::MaxPly - 1 << std::endl;
+		return 2;
+	}
+
+	uint64_t totalNodes = 0;
+	double totalSeconds = 0;
+
+	std::printf("{\n  \"depth\": %d,\n  \"positions\": [\n", depth);
+
+	for (size_t i = 0; i < sizeof(Suite) / sizeof(Suite[0]); ++i)
+	{
+		Board board;
+		std::istringstream moves(Suite[i].moves);
+		std::string move;
+
+		while (moves >> move)
+		{
+			int x, y;
+			std::sscanf(move.c_str(), "%d,%d", &x, &y);
+			board.makeMove(x, y);
+		}
+
+		TranspositionTable table(megabytes);
+		GameState state(board, &table);
+		std::vector<double> timeToDepth;
+		int x = -1, y = -1, score = 0;
+
+		auto start = std::chrono::steady_clock::now();
+		for (int d = 1; d <= depth; ++d)
+		{
+			state.bestMove(d, x, y, score);
+			timeToDepth.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		}
+
+		double seconds = timeToDepth.back();
+		uint64_t nodes = state.getStatistics().nodes;
+
+		totalNodes += nodes;
+		totalSeconds += seconds;
+
+		std::printf("    {\"name\": \"%s\", \"move\": [%d, %d], \"score\": %d, \"nodes\": %llu, \"seconds\": %.6f, \"nps\": %.0f, \"time_to_depth\": [", Suite[i].name, x, y, score, (unsigned long long)nodes, seconds, nodes / seconds);
+		for (size_t d = 0; d < timeToDepth.size(); ++d)
+			std::printf("%s%.6f", (d == 0) ? "" : ", ", timeToDepth[d]);
+		std::printf("], \"statistics\": %s}%s\n", state.getStatistics().toJson().c_str(), (i + 1 < sizeof(Suite) / sizeof(Suite[0])) ? "," : "");
+	}
+
+	Trace::flush();
+
+	double nodesPerSecond = totalNodes / totalSeconds;
+	std::printf("  ],\n  \"total\": {\"nodes\": %llu, \"seconds\": %.6f, \"nps\": %.0f}\n}\n", (unsigned long long)totalNodes, totalSeconds, nodesPerSecond);
+
+	if (baseline)
+	{
+		double before = baselineNodesPerSecond(baseline);
+
+		if (before < 0)
+		{
+			std::cerr << "woo-bench: no total nodes per second in " << baseline << std::endl;
+			return 2;
+		}
+		if (nodesPerSecond < before * (1 - tolerance / 100))
+		{
+			std::cerr << "woo-bench: " << nodesPerSecond << " nodes per second, down from " << before << std::endl;
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,137 @@
+#include "book.h"
+#include "game.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char OpeningBook::Magic[8] = {'W', 'O', 'O', 'B', 'O', 'O', 'K', '2'};
+
+bool OpeningBook::load(const char *path)
+{
+	unload();
+
+	int file = open(path, O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat status;
+	if (fstat(file, &status) != 0 || size_t(status.st_size) < sizeof(Header))
+	{
+		close(file);
+		return false;
+	}
+
+	void *contents = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, file, 0);
+	close(file);
+	if (contents == MAP_FAILED)
+		return false;
+
+	const Header *header = static_cast<const Header *>(contents);
+
+	if (std::memcmp(header->magic, Magic, sizeof(Magic)) != 0 || sizeof(Header) + size_t(header->numEntries) * sizeof(Entry) > size_t(status.st_size))
+	{
+		munmap(contents, status.st_size);
+		return false;
+	}
+
+	mapping = contents;
+	mappingSize = status.st_size;
+	entries = reinterpret_cast<const Entry *>(header + 1);
+	numEntries = header->numEntries;
+	maxPly = header->maxPly;
+
+	return true;
+}
+
+void OpeningBook::unload()
+{
+	if (mapping)
+		munmap(mapping, mappingSize);
+
+	mapping = nullptr;
+	mappingSize = 0;
+	entries = nullptr;
+	numEntries = 0;
+	maxPly = 0;
+}
+
+int OpeningBook::probe(const Board &board, std::mt19937 &random) const
+{
+	if (!entries || board.numSquareOccupied() >= maxPly)
+		return TranspositionTable::NoMove;
+
+	// The book holds the canonical form of the position, and its moves as they are there
+	int transform = board.getCanonicalTransform(), inverse = Board::inverseTransform(transform);
+	uint64_t key = board.getSymmetricKey(transform);
+	auto moveOf = [&](const Entry &entry)
+	{
+		if (entry.move >= Board::NumSquares)
+			return int(TranspositionTable::NoMove);
+
+		int move = Board::transformSquare(inverse, entry.move);
+		return board.squareOccupied(move % Board::SideLen, move / Board::SideLen) ? int(TranspositionTable::NoMove) : move;
+	};
+
+	const Entry *first = std::lower_bound(entries, entries + numEntries, key, [](const Entry &entry, uint64_t k)
+										  { return entry.key < k; });
+	const Entry *last = first;
+	uint32_t total = 0;
+
+	for (; last != entries + numEntries && last->key == key; ++last)
+	{
+		if (moveOf(*last) != TranspositionTable::NoMove)
+			total += last->weight;
+	}
+
+	if (total == 0)
+		return TranspositionTable::NoMove;
+
+	// A move the book plays more often is chosen more often
+	uint32_t pick = random() % total;
+
+	for (const Entry *entry = first; entry != last; ++entry)
+	{
+		int move = moveOf(*entry);
+
+		if (move != TranspositionTable::NoMove)
+		{
+			if (pick < entry->weight)
+				return move;
+			pick -= entry->weight;
+		}
+	}
+
+	return TranspositionTable::NoMove;
+}
+
+bool OpeningBook::write(const char *path, std::vector<Entry> entries, uint32_t maxPly)
+{
+	std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b)
+			  { return (a.key != b.key) ? a.key < b.key : a.weight > b.weight; });
+
+	// Written beside the book and renamed over it, since a game may have the old one mapped
+	std::string temporary = std::string(path) + ".tmp";
+	std::FILE *file = std::fopen(temporary.c_str(), "wb");
+	if (!file)
+		return false;
+
+	Header header;
+	std::memcpy(header.magic, Magic, sizeof(Magic));
+	header.numEntries = entries.size();
+	header.maxPly = maxPly;
+
+	bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 && std::fwrite(entries.data(), sizeof(Entry), entries.size(), file) == entries.size();
+
+	if (std::fclose(file) != 0 || !written || std::rename(temporary.c_str(), path) != 0)
+	{
+		std::remove(temporary.c_str());
+		return false;
+	}
+
+	return true;
+}
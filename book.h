@@ -0,0 +1,76 @@
+#ifndef BOOK_H_
+#define BOOK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+class Board;
+
+/**
+ * Opening book: moves for the first plies of the game, by the canonical key of the position
+ * (see Board::getCanonicalKey), so that one entry serves all its rotations and reflections.
+ * The file is a header and then entries sorted by key, several for a position that has several
+ * moves, in the byte order of the machine that built it. It is mapped into memory rather than read,
+ * so that loading costs nothing until a position is looked up.
+ */
+class OpeningBook
+{
+public:
+	struct Entry
+	{
+		uint64_t key;
+		uint16_t move; // x + y * Board::SideLen in the canonical form of the position
+		uint16_t weight;
+		uint32_t reserved;
+	};
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t numEntries;
+		uint32_t maxPly; // positions with this many stones or more are not in the book
+	};
+
+private:
+	static const char Magic[8];
+
+	void *mapping;
+	size_t mappingSize;
+
+	const Entry *entries;
+	uint32_t numEntries;
+	uint32_t maxPly;
+
+public:
+	OpeningBook() : mapping(nullptr), mappingSize(0), entries(nullptr), numEntries(0), maxPly(0) {}
+	~OpeningBook() { unload(); }
+
+	OpeningBook(const OpeningBook &) = delete;
+	OpeningBook &operator=(const OpeningBook &) = delete;
+
+	/**
+	 * Map the book at path in place of the current one. Return false, with no book loaded,
+	 * if it cannot be opened or is not a book.
+	 */
+	bool load(const char *path);
+	void unload();
+
+	bool isLoaded() const { return entries != nullptr; }
+	size_t size() const { return numEntries; }
+
+	/**
+	 * A move of the book for the position, chosen at random in proportion to the weights,
+	 * or TranspositionTable::NoMove if the position is not in the book.
+	 */
+	int probe(const Board &, std::mt19937 &random) const;
+
+	/**
+	 * Write a book of entries, in any order, to path. Return false if it cannot be written.
+	 * A book already at path is replaced whole, so that a game that has it mapped keeps the old one.
+	 */
+	static bool write(const char *path, std::vector<Entry> entries, uint32_t maxPly);
+};
+
+#endif
@@ -0,0 +1,163 @@
+#include "book.h"
+#include "game.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * How the book is grown: every position reached within plies moves is searched for each of its
+ * candidate moves to depth, and the best of them, up to width and within margin of the best,
+ * go in the book and are followed in turn.
+ */
+struct Settings
+{
+	int plies = 8;
+	int depth = 5;
+	int width = 2;
+	int margin = 200;
+	size_t hash = 64;
+};
+
+class BookBuilder
+{
+private:
+	const Settings &settings;
+	TranspositionTable table;
+	std::unordered_set<uint64_t> visited;
+	std::vector<OpeningBook::Entry> entries;
+
+	void add(const Board &board, int move, int weight)
+	{
+		int transform = board.getCanonicalTransform();
+
+		entries.push_back(OpeningBook::Entry{board.getSymmetricKey(transform), uint16_t(Board::transformSquare(transform, move)), uint16_t(weight), 0});
+	}
+
+	void expand(Board &board)
+	{
+		if (int(board.numSquareOccupied()) >= settings.plies || board.gameStatus() != 'r' || !visited.insert(board.getCanonicalKey()).second)
+			return;
+
+		struct Scored
+		{
+			int move;
+			int score;
+		};
+		std::vector<Scored> moves;
+
+		if (board.numSquareOccupied() == 0)
+			moves.push_back(Scored{Board::SideLen / 2 + Board::SideLen / 2 * Board::SideLen, 0});
+		else
+		{
+			// Each candidate is scored by a search of the position it leads to
+			for (int y = 0; y < Board::SideLen; ++y)
+			{
+				for (unsigned row = board.getCandidates()[y]; row != 0; row &= row - 1)
+				{
+					int x = __builtin_ctz(row), bestX, bestY, score;
+
+					board.makeMove(x, y);
+					if (board.gameStatus() != 'r')
+						score = (board.gameStatus() == 'd') ? 0 : -GameState::WinScore;
+					else
+					{
+						GameState state(board, &table);
+						state.bestMove(settings.depth - 1, bestX, bestY, score);
+					}
+					board.unmakeMove();
+
+					moves.push_back(Scored{x + y * Board::SideLen, -score});
+				}
+			}
+
+			std::stable_sort(moves.begin(), moves.end(), [](const Scored &a, const Scored &b)
+							 { return a.score > b.score; });
+		}
+
+		int best = moves.front().score;
+		std::unordered_set<uint64_t> chosen;
+
+		for (int i = 0; i < int(moves.size()) && int(chosen.size()) < settings.width && moves[i].score >= best - settings.margin; ++i)
+		{
+			// A rotation or reflection of a move already chosen is the same move
+			if (!chosen.insert(board.getCanonicalKeyAfter(moves[i].move % Board::SideLen, moves[i].move / Board::SideLen)).second)
+				continue;
+
+			// Weighted by how close to the best it is, at least 1
+			add(board, moves[i].move, 1 + settings.margin - (best - moves[i].score));
+
+			board.makeMove(moves[i].move % Board::SideLen, moves[i].move / Board::SideLen);
+			expand(board);
+			board.unmakeMove();
+		}
+
+		std::fprintf(stderr, "\r%zu positions", visited.size());
+	}
+
+public:
+	explicit BookBuilder(const Settings &bookSettings) : settings(bookSettings), table(bookSettings.hash) {}
+
+	const std::vector<OpeningBook::Entry> &build()
+	{
+		Board board;
+
+		expand(board);
+		std::fprintf(stderr, "\n");
+
+		return entries;
+	}
+};
+
+/**
+ * Build an opening book offline, from searches of the positions the engine and its likely opponents
+ * reach in the first plies, for Game::loadBook.
+ *
+ * Usage: woo-book [-p plies] [-d depth] [-w width] [-r margin] [-m megabytes] [-o file]
+ */
+int main(int argc, char **argv)
+{
+	Settings settings;
+	const char *path = "woo.book";
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+			settings.plies = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+			settings.depth = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+			settings.width = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+			settings.margin = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+			settings.hash = std::strtoul(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			path = argv[++i];
+		else
+		{
+			std::cerr << "usage: woo-book [-p plies] [-d depth] [-w width] [-r margin] [-m megabytes] [-o file]" << std::endl;
+			return 2;
+		}
+	}
+
+	if (settings.depth < 2 || settings.depth >= GameState::MaxPly || settings.plies < 1 || settings.width < 1 || settings.margin < 0 || settings.margin >= 65535)
+	{
+		std::cerr << "woo-book: bad settings" << std::endl;
+		return 2;
+	}
+
+	BookBuilder builder(settings);
+	const std::vector<OpeningBook::Entry> &entries = builder.build();
+
+	if (!OpeningBook::write(path, entries, settings.plies))
+	{
+		std::cerr << "woo-book: cannot write " << path << std::endl;
+		return 1;
+	}
+
+	std::printf("%zu moves written to %s\n", entries.size(), path);
+	return 0;
+}
@@ -1,13 +1,12 @@
 #include "game.h"
+#include "proof.h"
+#include "threat.h"
+#include "trace.h"
 #include <algorithm>
-#include <numeric>
 #include <climits>
 #include <iostream>
-
-Player adversaryOf(const Player p)
-{
-	return ((p == X) ? O : X);
-}
+#include <sstream>
+#include <thread>
 
 const Square &Square::operator=(const Square &other)
 {
@@ -31,27 +30,161 @@ bool PieceStrip::hasAWinningConnection() const
 	return false;
 }
 
-Board::Board() : mostRecentlyModifiedSquare(nullptr)
+Board::Board() : lines(), moves(), numMoves(0), keys(), lineScores(), patternScores(), candidates(), candidateRadius(2)
+{
+}
+
+const int Board::Directions[4][2] = {{1, 0}, {0, 1}, {1, 1}, {1, -1}};
+
+const std::array<uint16_t, Board::NumLines> Board::LineMasks = []
 {
+	std::array<uint16_t, NumLines> masks{};
+
 	for (int x = 0; x < SideLen; ++x)
 	{
 		for (int y = 0; y < SideLen; ++y)
 		{
-			getSquare(x, y).setCoord(x, y);
+			for (size_t direction = 0; direction < 4; ++direction)
+				masks.at(lineOf(direction, x, y)) |= 1 << positionOf(direction, x, y);
+		}
+	}
+
+	return masks;
+}();
+
+const std::array<std::array<uint64_t, Board::NumSquares>, 2> Board::ZobristKeys = []
+{
+	std::array<std::array<uint64_t, NumSquares>, 2> keys;
+	uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+	// splitmix64, so that keys are the same on every run
+	for (auto &player : keys)
+	{
+		for (auto &k : player)
+		{
+			uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			k = z ^ (z >> 31);
+		}
+	}
+
+	return keys;
+}();
+
+const std::array<std::array<uint8_t, Board::NumSquares>, Board::NumSymmetries> Board::Symmetries = []
+{
+	std::array<std::array<uint8_t, NumSquares>, NumSymmetries> squares;
+
+	for (int transform = 0; transform < NumSymmetries; ++transform)
+	{
+		for (int square = 0; square < NumSquares; ++square)
+		{
+			int x = square % SideLen, y = square / SideLen;
+
+			if (transform & 4)
+				std::swap(x, y);
+			if (transform & 1)
+				x = SideLen - 1 - x;
+			if (transform & 2)
+				y = SideLen - 1 - y;
+			squares[transform][square] = x + y * SideLen;
+		}
+	}
+
+	return squares;
+}();
+
+const std::array<int, Board::NumSymmetries> Board::InverseSymmetries = []
+{
+	std::array<int, NumSymmetries> inverses{};
+
+	for (int transform = 0; transform < NumSymmetries; ++transform)
+	{
+		for (int inverse = 0; inverse < NumSymmetries; ++inverse)
+		{
+			bool undoes = true;
+
+			for (int square = 0; square < NumSquares && undoes; ++square)
+				undoes = Symmetries[inverse][Symmetries[transform][square]] == square;
+			if (undoes)
+				inverses[transform] = inverse;
+		}
+	}
+
+	return inverses;
+}();
+
+const std::array<std::array<std::array<uint64_t, Board::NumSymmetries>, Board::NumSquares>, 2> Board::SymmetricKeys = []
+{
+	std::array<std::array<std::array<uint64_t, NumSymmetries>, NumSquares>, 2> keys;
+
+	for (int player = 0; player < 2; ++player)
+	{
+		for (int square = 0; square < NumSquares; ++square)
+		{
+			for (int transform = 0; transform < NumSymmetries; ++transform)
+				keys[player][square][transform] = ZobristKeys[player][Symmetries[transform][square]];
 		}
 	}
+
+	return keys;
+}();
+
+int Board::lineOf(size_t direction, int x, int y)
+{
+	switch (direction)
+	{
+	case 0:
+		return y;
+	case 1:
+		return SideLen + x;
+	case 2:
+		return 2 * SideLen + x - y + SideLen - 1;
+	default:
+		return 2 * SideLen + NumDiagonals + x + y;
+	}
 }
 
-const int Board::Directions[4][2] = {{1, 0}, {0, 1}, {1, 1}, {1, -1}};
+void Board::setOccupant(int x, int y, Player player)
+{
+	for (size_t direction = 0; direction < 4; ++direction)
+	{
+		uint16_t bit = 1 << positionOf(direction, x, y);
+
+		lines[0][lineOf(direction, x, y)] &= ~bit;
+		lines[1][lineOf(direction, x, y)] &= ~bit;
 
-const Board &Board::operator=(const Board &other)
+		if (player == X || player == O)
+			lines[player - X][lineOf(direction, x, y)] |= bit;
+	}
+}
+
+void Board::updateLineScores(int x, int y)
 {
-	if (squares == other.squares)
-		return *this;
+	for (size_t direction = 0; direction < 4; ++direction)
+	{
+		int line = lineOf(direction, x, y);
+		unsigned offBoard = ~unsigned(LineMasks[line]);
 
-	squares = other.squares;
-	mostRecentlyModifiedSquare = &getSquare(other.mostRecentlyModifiedSquare->getX(), other.mostRecentlyModifiedSquare->getY());
-	return *this;
+		for (size_t player = 0; player < 2; ++player)
+		{
+			int score = MoveAnalyser::scoreOfLine(lines[player][line] | offBoard, lines[1 - player][line] | offBoard);
+
+			patternScores[player] += score - lineScores[player][line];
+			lineScores[player][line] = score;
+		}
+	}
+}
+
+Square Board::getSquare(int x, int y) const
+{
+	if ((lines[0].at(y) >> x) & 1)
+		return Square(x, y, X);
+	else if ((lines[1].at(y) >> x) & 1)
+		return Square(x, y, O);
+	else
+		return Square(x, y, Nobody);
 }
 
 bool Board::draw() const
@@ -64,15 +197,17 @@ char Board::gameStatus() const
 	if (draw())
 		return 'd';
 
-	for (auto const &s : getSurroundingPieces(mostRecentlyModifiedSquare->getX(), mostRecentlyModifiedSquare->getY()))
+	if (numMoves == 0)
+		return 'r';
+
+	Square lastMove = getMostRecentlyModifiedSquare();
+
+	for (size_t direction = 0; direction < 4; ++direction)
 	{
-		if (s.hasAWinningConnection())
-		{
-			if (getCurrentPlayer() == X) // if the previous turn was O's
-				return 'o';
-			else
-				return 'x';
-		}
+		unsigned w = windowOf(lines[lastMove.getPlayer() - X][lineOf(direction, lastMove.getX(), lastMove.getY())], positionOf(direction, lastMove.getX(), lastMove.getY()));
+
+		if (w & (w >> 1) & (w >> 2) & (w >> 3) & (w >> 4))
+			return (lastMove.getPlayer() == X) ? 'x' : 'o';
 	}
 
 	return 'r';
@@ -84,57 +219,125 @@ std::array<PieceStrip, 4> Board::getSurroundingPieces(int x, int y) const
 
 	for (size_t direction = 0; direction < 4; ++direction)
 	{
-		surroundings.at(direction).setPlayer(4, getSquare(x, y).getPlayer());
-
-		for (int distance = 4; distance > 0; --distance)
+		int line = lineOf(direction, x, y);
+		int position = positionOf(direction, x, y);
+		unsigned xs = windowOf(lines[0][line], position);
+		unsigned os = windowOf(lines[1][line], position);
+		unsigned valid = windowOf(LineMasks[line], position);
+
+		// Strip index 4 - distance lies in the positive direction, i.e. at bit 4 + distance of the window
+		for (size_t i = 0; i < 9; ++i)
 		{
-			if (coordValid(x + distance * Directions[direction][0], y + distance * Directions[direction][1]))
-				surroundings.at(direction).setPlayer(4 - distance, getSquare(x + distance * Directions[direction][0], y + distance * Directions[direction][1]).getPlayer());
-			else
-				surroundings.at(direction).setPlayer(4 - distance, Invalid);
-
-			if (coordValid(x - distance * Directions[direction][0], y - distance * Directions[direction][1]))
-				surroundings.at(direction).setPlayer(4 + distance, getSquare(x - distance * Directions[direction][0], y - distance * Directions[direction][1]).getPlayer());
+			unsigned bit = 1 << (8 - i);
+
+			if (xs & bit)
+				surroundings[direction].setPlayer(i, X);
+			else if (os & bit)
+				surroundings[direction].setPlayer(i, O);
+			else if (valid & bit)
+				surroundings[direction].setPlayer(i, Nobody);
 			else
-				surroundings.at(direction).setPlayer(4 + distance, Invalid);
+				surroundings[direction].setPlayer(i, Invalid);
 		}
 	}
 
 	return surroundings;
 }
 
-Board::Board(const Board &other) : squares(other.squares), mostRecentlyModifiedSquare(nullptr)
+std::array<unsigned, 4> Board::getSurroundingStrips(int x, int y, Player player) const
 {
-	std::transform(other.occupiedSquares.cbegin(), other.occupiedSquares.cend(), std::back_inserter(occupiedSquares), [this](const Square &s)
-				   { return getSquare(s.getX(), s.getY()); });
+	std::array<unsigned, 4> strips;
+
+	for (size_t direction = 0; direction < 4; ++direction)
+	{
+		int line = lineOf(direction, x, y);
+		int position = positionOf(direction, x, y);
+		unsigned offBoard = ~windowOf(LineMasks[line], position) & 0x1FF;
+
+		strips[direction] = ((windowOf(lines[player - X][line], position) | offBoard) << 9) | windowOf(lines[adversaryOf(player) - X][line], position) | offBoard;
+	}
+
+	return strips;
 }
 
-Board::Board(const Board &other, int moveX, int moveY) : squares(other.squares)
+Board::Board(const Board &other, int moveX, int moveY) : Board(other)
 {
-	getSquare(moveX, moveY).setPlayer(getCurrentPlayer());
-	mostRecentlyModifiedSquare = &getSquare(moveX, moveY);
+	makeMove(moveX, moveY);
+}
 
-	std::transform(other.occupiedSquares.cbegin(), other.occupiedSquares.cend(), std::back_inserter(occupiedSquares), [this](const Square &s)
-				   { return getSquare(s.getX(), s.getY()); });
+int Board::numSquaresOccupiedBy(Player player) const
+{
+	if (player == Nobody)
+		return NumSquares - numMoves;
+	else if (player != X && player != O)
+		return 0;
 
-	occupiedSquares.push_back(getSquare(moveX, moveY));
+	int count = 0;
+	for (int y = 0; y < SideLen; ++y)
+		count += __builtin_popcount(lines[player - X][y]);
+	return count;
 }
 
-int Board::numSquaresOccupiedBy(Player player) const
+void Board::addCandidates(int x, int y)
+{
+	for (int distance = 1; distance <= candidateRadius; ++distance)
+	{
+		candidates[y] |= ((1u << x) << distance) | ((1u << x) >> distance);
+
+		for (int q : {y - distance, y + distance})
+		{
+			if (q >= 0 && q < SideLen)
+				candidates[q] |= (((1u << x) << distance) | (1u << x) | ((1u << x) >> distance)) & ~(lines[0][q] | lines[1][q]) & LineMasks[q];
+		}
+	}
+
+	candidates[y] &= ~(lines[0][y] | lines[1][y]) & LineMasks[y];
+}
+
+void Board::updateCandidates(int y)
+{
+	for (int q = std::max(y - candidateRadius, 0); q <= std::min(y + candidateRadius, SideLen - 1); ++q)
+	{
+		unsigned occupied = lines[0][q] | lines[1][q];
+		unsigned nearby = 0;
+
+		for (int distance = 1; distance <= candidateRadius; ++distance)
+		{
+			nearby |= (occupied << distance) | (occupied >> distance);
+
+			for (int r : {q - distance, q + distance})
+			{
+				if (r >= 0 && r < SideLen)
+				{
+					unsigned other = lines[0][r] | lines[1][r];
+					nearby |= other | (other << distance) | (other >> distance);
+				}
+			}
+		}
+
+		candidates[q] = nearby & ~occupied & LineMasks[q];
+	}
+}
+
+void Board::setCandidateRadius(int radius)
 {
-	return std::count_if(squares.cbegin(), squares.cend(), [player](const Square &s)
-						 { return s.getPlayer() == player; });
+	candidateRadius = std::min(std::max(radius, 1), int(MaxCandidateRadius));
+
+	for (int y = 0; y < SideLen; ++y)
+		updateCandidates(y);
 }
 
 bool Board::hasOccupiedSquaresNearby(int x, int y) const
 {
+	// Every position within candidateRadius of (x, y) except its own
+	unsigned neighbourhood = ((1u << (2 * candidateRadius + 1)) - 1) & ~(1u << candidateRadius);
+
 	for (size_t direction = 0; direction < 4; ++direction)
 	{
-		for (int distance = 1; distance <= 2 /* magic number here! */; ++distance)
-		{
-			if ((coordValid(x + Directions[direction][0] * distance, y + Directions[direction][1] * distance) && squareOccupied(x + Directions[direction][0] * distance, y + Directions[direction][1] * distance)) || (coordValid(x - Directions[direction][0] * distance, y - Directions[direction][1] * distance) && squareOccupied(x - Directions[direction][0] * distance, y - Directions[direction][1] * distance)))
-				return true;
-		}
+		int line = lineOf(direction, x, y);
+
+		if ((((unsigned(lines[0][line] | lines[1][line]) << candidateRadius) >> positionOf(direction, x, y)) & neighbourhood) != 0)
+			return true;
 	}
 	return false;
 }
@@ -144,44 +347,62 @@ bool Board::terminatingMove(int x, int y) const
 	return Board(*this, x, y).gameStatus() != 'r';
 }
 
-Player Board::getCurrentPlayer() const
+uint64_t Board::getCanonicalKeyAfter(int x, int y) const
 {
-	return ((numSquaresOccupiedBy(X) > numSquaresOccupiedBy(O)) ? O : X);
+	const std::array<uint64_t, NumSymmetries> &added = SymmetricKeys[getCurrentPlayer() - X][x + y * SideLen];
+	uint64_t least = keys[0] ^ added[0];
+
+	for (int transform = 1; transform < NumSymmetries; ++transform)
+		least = std::min(least, keys[transform] ^ added[transform]);
+
+	return least;
 }
 
 void Board::makeMove(int x, int y)
 {
-	getSquare(x, y).setPlayer(getCurrentPlayer());
-	mostRecentlyModifiedSquare = &getSquare(x, y);
-
-	occupiedSquares.push_back(getSquare(x, y));
+	const std::array<uint64_t, NumSymmetries> &added = SymmetricKeys[getCurrentPlayer() - X][x + y * SideLen];
+
+	for (int transform = 0; transform < NumSymmetries; ++transform)
+		keys[transform] ^= added[transform];
+	setOccupant(x, y, getCurrentPlayer());
+	updateLineScores(x, y);
+	addCandidates(x, y);
+	moves.at(numMoves++) = x + y * SideLen;
 }
 
-void Board::undo()
+void Board::unmakeMove()
 {
-	getSquare(occupiedSquares.crbegin()->getX(), occupiedSquares.crbegin()->getY()).setPlayer(Nobody);
-	occupiedSquares.pop_back();
+	--numMoves;
+	const std::array<uint64_t, NumSymmetries> &removed = SymmetricKeys[getCurrentPlayer() - X][moves.at(numMoves)];
 
-	getSquare(occupiedSquares.crbegin()->getX(), occupiedSquares.crbegin()->getY()).setPlayer(Nobody);
-	occupiedSquares.pop_back();
+	for (int transform = 0; transform < NumSymmetries; ++transform)
+		keys[transform] ^= removed[transform];
+	int x = moves.at(numMoves) % SideLen, y = moves.at(numMoves) / SideLen;
 
-	mostRecentlyModifiedSquare = &getSquare(occupiedSquares.crbegin()->getX(), occupiedSquares.crbegin()->getY());
+	setOccupant(x, y, Nobody);
+	updateLineScores(x, y);
+	updateCandidates(y);
 }
 
-void Board::clear()
+void Board::undo()
 {
-	for (auto &it : squares)
-	{
-		if (it.getPlayer() != Nobody)
-			it.setPlayer(Nobody);
-	}
+	unmakeMove();
+	unmakeMove();
+}
 
-	occupiedSquares.clear();
+void Board::clear()
+{
+	lines = {};
+	numMoves = 0;
+	keys = {};
+	lineScores = {};
+	patternScores = {};
+	candidates = {};
 }
 
 const std::array<const std::string, 22> MoveAnalyser::Patterns({"11111", "011110", "011112", "0101110", "0110110", "01110", "010110", "001112", "010112", "011012", "10011", "10101", "2011102", "00110", "01010", "010010", "000112", "001012", "010012", "10001", "2010102", "2011002"});
 
-int MoveAnalyser::scoreOfPattern(size_t patternSubscript) const
+int MoveAnalyser::scoreOfPattern(size_t patternSubscript)
 {
 	int score = 0;
 	switch (patternSubscript)
@@ -228,7 +449,7 @@ int MoveAnalyser::scoreOfPattern(size_t patternSubscript) const
 	return score;
 }
 
-int MoveAnalyser::getScoreOfStrip(const PieceStrip &strip) const
+int MoveAnalyser::getScoreOfStrip(const PieceStrip &strip, Player evaluatedPlayer)
 {
 	int score = 0;
 
@@ -236,21 +457,26 @@ int MoveAnalyser::getScoreOfStrip(const PieceStrip &strip) const
 	{
 		for (size_t pieceSubscript = 0; pieceSubscript <= 9 - Patterns[patternSubscript].length(); ++pieceSubscript)
 		{
-			std::string searched;
+			size_t i = 0;
 
-			for (size_t i = 0; i < Patterns[patternSubscript].length(); ++i)
+			for (; i < Patterns[patternSubscript].length(); ++i)
 			{
+				char searched;
+
 				if (strip.at(pieceSubscript + i) == evaluatedPlayer)
-					searched.push_back('1');
+					searched = '1';
 				else if (strip.at(pieceSubscript + i) == adversaryOf(evaluatedPlayer))
-					searched.push_back('2');
+					searched = '2';
 				else if (strip.at(pieceSubscript + i) == Nobody)
-					searched.push_back('0');
+					searched = '0';
 				else
-					searched.push_back('i'); // 'I'nvalid
+					searched = 'i'; // 'I'nvalid
+
+				if (searched != Patterns[patternSubscript][i])
+					break;
 			}
 
-			if (searched == Patterns[patternSubscript])
+			if (i == Patterns[patternSubscript].length())
 			{
 				score += scoreOfPattern(patternSubscript);
 			}
@@ -260,220 +486,1200 @@ int MoveAnalyser::getScoreOfStrip(const PieceStrip &strip) const
 	return score;
 }
 
-MoveAnalyser::MoveAnalyser(const Board &analysedBoard, int x, int y) : evaluatedPlayer(analysedBoard.getSquare(x, y).getPlayer()), analysedStrips(analysedBoard.getSurroundingPieces(x, y))
+const std::vector<int> MoveAnalyser::StripScores = []
+{
+	std::vector<int> scores(1 << 18);
+
+	for (unsigned code = 0; code < scores.size(); ++code)
+	{
+		PieceStrip strip;
+
+		for (size_t i = 0; i < 9; ++i)
+		{
+			bool mine = (code >> (9 + 8 - i)) & 1;
+			bool adversarys = (code >> (8 - i)) & 1;
+
+			if (mine && adversarys)
+				strip.setPlayer(i, Invalid);
+			else if (mine)
+				strip.setPlayer(i, X);
+			else if (adversarys)
+				strip.setPlayer(i, O);
+			else
+				strip.setPlayer(i, Nobody);
+		}
+
+		scores[code] = getScoreOfStrip(strip, X);
+	}
+
+	return scores;
+}();
+
+const std::vector<int> MoveAnalyser::PatternStartScores = []
+{
+	std::vector<int> scores(1 << 14);
+
+	for (unsigned code = 0; code < scores.size(); ++code)
+	{
+		std::string squares;
+
+		for (size_t i = 0; i < 7; ++i)
+		{
+			bool mine = (code >> (7 + i)) & 1;
+			bool adversarys = (code >> i) & 1;
+
+			squares.push_back((mine && adversarys) ? 'i' : mine ? '1' : adversarys ? '2' : '0');
+		}
+
+		for (size_t patternSubscript = 0; patternSubscript < 22; ++patternSubscript)
+		{
+			std::string pattern = Patterns[patternSubscript];
+			std::string mirrored(pattern.crbegin(), pattern.crend());
+
+			if (squares.compare(0, pattern.length(), pattern) == 0)
+				scores[code] += scoreOfPattern(patternSubscript);
+			if (mirrored != pattern && squares.compare(0, mirrored.length(), mirrored) == 0)
+				scores[code] += scoreOfPattern(patternSubscript);
+		}
+	}
+
+	return scores;
+}();
+
+int MoveAnalyser::scoreOfLine(unsigned mine, unsigned adversarys)
+{
+	int score = 0;
+
+	for (int start = 0; start < Board::SideLen; ++start)
+		score += PatternStartScores[(((mine >> start) & 0x7F) << 7) | ((adversarys >> start) & 0x7F)];
+
+	return score;
+}
+
+MoveAnalyser::MoveAnalyser(const Board &analysedBoard, int x, int y) : analysedStrips(analysedBoard.getSurroundingStrips(x, y, analysedBoard.getSquare(x, y).getPlayer()))
 {
 }
 
-MoveAnalyser::MoveAnalyser(const Board &analysedBoard, int x, int y, Player analysedPlayer) : evaluatedPlayer(analysedPlayer), analysedStrips(analysedBoard.getSurroundingPieces(x, y))
+MoveAnalyser::MoveAnalyser(const Board &analysedBoard, int x, int y, Player analysedPlayer) : analysedStrips(analysedBoard.getSurroundingStrips(x, y, analysedPlayer))
 {
 	for (auto &strip : analysedStrips)
 	{
-		strip.setPlayer(4, evaluatedPlayer);
+		strip = (strip | (1 << (9 + 4))) & ~(1 << 4);
 	}
 }
 
 int MoveAnalyser::analysisResult() const
 {
-	return std::accumulate(analysedStrips.cbegin(), analysedStrips.cend(), 0, [this](int previousScoreSum, const PieceStrip &s)
-						   { return previousScoreSum + getScoreOfStrip(s); });
+	return StripScores[analysedStrips[0]] + StripScores[analysedStrips[1]] + StripScores[analysedStrips[2]] + StripScores[analysedStrips[3]];
+}
+
+void TranspositionTable::resize(size_t megabytes)
+{
+	size_t numSlots = 1;
+	while (numSlots * 2 * sizeof(Slot) <= megabytes * 1024 * 1024)
+		numSlots *= 2;
+
+	slots = std::vector<Slot>(numSlots);
+	clear();
 }
 
-size_t GameState::numMovesMadeSoFarWhenCalled = 0;
+void TranspositionTable::clear()
+{
+	for (auto &slot : slots)
+	{
+		slot.check.store(0, std::memory_order_relaxed);
+		slot.data.store(0, std::memory_order_relaxed);
+	}
+}
 
-GameState::GameState(const Board &b, int moveX, int moveY) : board(b, moveX, moveY)
+// Bits 0-31 score, 32-39 depth, 40-47 bound, 48-55 move, bit 63 set in every entry
+uint64_t TranspositionTable::pack(const Entry &entry)
 {
+	return uint64_t(uint32_t(entry.score)) | (uint64_t(uint8_t(entry.depth)) << 32) | (uint64_t(entry.bound) << 40) | (uint64_t(entry.move) << 48) | (uint64_t(1) << 63);
 }
 
-int GameState::recentMovesAnalysisResult(Player player) const
+TranspositionTable::Entry TranspositionTable::unpack(uint64_t key, uint64_t data)
 {
-	int scoreSum = 0;
+	return Entry{key, int(uint32_t(data)), int8_t(uint8_t(data >> 32)), uint8_t(data >> 40), uint8_t(data >> 48)};
+}
 
-	for (size_t moveIndex = numMovesMadeSoFarWhenCalled; moveIndex < board.numSquareOccupied(); ++moveIndex)
-	{
-		auto analysedSquare = board.getSquare(moveIndex);
-		Player thisMovesPlayer = analysedSquare.getPlayer();
+bool TranspositionTable::probe(const Board &board, Entry &entry) const
+{
+	int transform = board.getCanonicalTransform();
 
-		int score = MoveAnalyser(board, analysedSquare.getX(), analysedSquare.getY()).analysisResult();
-		score += MoveAnalyser(board, analysedSquare.getX(), analysedSquare.getY(), adversaryOf(thisMovesPlayer)).analysisResult();
+	if (!probe(board.getSymmetricKey(transform), entry))
+		return false;
 
-		if (thisMovesPlayer == player)
-			scoreSum += score;
-		else
-			scoreSum -= score;
-	}
+	// The move is stored as it is in the canonical form
+	if (entry.move != UINT8_MAX)
+		entry.move = Board::transformSquare(Board::inverseTransform(transform), entry.move);
+	return true;
+}
+
+void TranspositionTable::store(const Board &board, int depth, Bound bound, int score, int move)
+{
+	int transform = board.getCanonicalTransform();
+
+	store(board.getSymmetricKey(transform), depth, bound, score, (move == NoMove) ? NoMove : Board::transformSquare(transform, move));
+}
 
-	return scoreSum;
-	// int score = MoveAnalyser(board, board.mostRecentlyModifiedSquare->getX(), board.mostRecentlyModifiedSquare->getY()).analysisResult(); // For the last mover, how brilliant the move was!
+bool TranspositionTable::probe(uint64_t key, Entry &entry) const
+{
+	const Slot &slot = slots[key & (slots.size() - 1)];
+	uint64_t data = slot.data.load(std::memory_order_relaxed);
 
-	// score += MoveAnalyser(board, board.mostRecentlyModifiedSquare->getX(), board.mostRecentlyModifiedSquare->getY(), currentPlayer).analysisResult(); // From the last mover's point of view, if the adversary ever moved here, how terrible that would be! So it was lucky of me to block his wicked move.
+	if (data == 0 || (slot.check.load(std::memory_order_relaxed) ^ data) != key)
+		return false;
 
-	// if (player == lastMover)
-	// 	return score; // Boy, you did a good job!
-	// else
-	// 	return -score; // Damn, what a move the enemy has made!
+	entry = unpack(key, data);
+	return true;
 }
 
-int GameState::utility(Player player) const
+void TranspositionTable::store(uint64_t key, int depth, Bound bound, int score, int move)
 {
-	char status = board.gameStatus();
+	Slot &slot = slots[key & (slots.size() - 1)];
+	uint64_t data = slot.data.load(std::memory_order_relaxed);
 
-	if (status == 'd')
+	if (data != 0 && (slot.check.load(std::memory_order_relaxed) ^ data) == key && depth < unpack(key, data).depth)
+		return;
+
+	data = pack(Entry{key, score, int8_t(depth), uint8_t(bound), uint8_t((move == NoMove) ? UINT8_MAX : move)});
+	slot.check.store(key ^ data, std::memory_order_relaxed);
+	slot.data.store(data, std::memory_order_relaxed);
+}
+
+GameState::Statistics &GameState::Statistics::operator+=(const Statistics &other)
+{
+	nodes += other.nodes;
+	quiescenceNodes += other.quiescenceNodes;
+	cutoffs += other.cutoffs;
+	leaves += other.leaves;
+	tableProbes += other.tableProbes;
+	tableHits += other.tableHits;
+
+	for (size_t i = 0; i < cutoffIndices.size(); ++i)
+		cutoffIndices[i] += other.cutoffIndices[i];
+	for (size_t i = 0; i < nodesAtPly.size(); ++i)
+		nodesAtPly[i] += other.nodesAtPly[i];
+
+	return *this;
+}
+
+double GameState::Statistics::effectiveBranchingFactor() const
+{
+	if (iterations.size() < 2 || iterations[iterations.size() - 2].nodes == 0)
 		return 0;
-	else if (status == 'r')
-	{
-		return recentMovesAnalysisResult(player);
-	}
-	else
-	{
-		if (player == ((status == 'x') ? X : O))
-			return INT_MAX;
-		else
-			return INT_MIN;
-	}
+
+	return double(iterations.back().nodes) / iterations[iterations.size() - 2].nodes;
 }
 
-GameState GameState::result(const Coord &move) const
+double GameState::Statistics::tableHitRate() const
 {
-	return GameState(board, move.x, move.y);
+	return (tableProbes == 0) ? 0 : double(tableHits) / tableProbes;
 }
 
-std::vector<GameState::Coord> GameState::actions() const
+std::string GameState::Statistics::toJson() const
 {
-	std::vector<GameState::Coord> moves;
+	std::ostringstream json;
 
-	for (int x = 0; x < Board::SideLen; ++x)
+	auto list = [&json](const char *name, const uint64_t *begin, const uint64_t *end)
 	{
-		for (int y = 0; y < Board::SideLen; ++y)
-		{
-			if (!board.squareOccupied(x, y) && board.hasOccupiedSquaresNearby(x, y))
-				moves.push_back(Coord(x, y));
-		}
-	}
+		json << ", \"" << name << "\": [";
+		for (const uint64_t *i = begin; i != end; ++i)
+			json << ((i == begin) ? "" : ", ") << *i;
+		json << ']';
+	};
+
+	json << "{\"nodes\": " << nodes << ", \"quiescence_nodes\": " << quiescenceNodes << ", \"cutoffs\": " << cutoffs;
+	list("cutoff_indices", cutoffIndices.data(), cutoffIndices.data() + cutoffIndices.size());
+	json << ", \"detailed\": " << (Detailed ? "true" : "false") << ", \"leaves\": " << leaves << ", \"table_probes\": " << tableProbes << ", \"table_hits\": " << tableHits << ", \"table_hit_rate\": " << tableHitRate();
+
+	// Plies beyond the deepest one reached are left out
+	size_t plies = nodesAtPly.size();
+	while (plies > 0 && nodesAtPly[plies - 1] == 0)
+		--plies;
+	list("nodes_at_ply", nodesAtPly.data(), nodesAtPly.data() + plies);
+
+	json << ", \"effective_branching_factor\": " << effectiveBranchingFactor() << ", \"iterations\": [";
+	for (size_t i = 0; i < iterations.size(); ++i)
+		json << ((i == 0) ? "" : ", ") << "{\"depth\": " << iterations[i].depth << ", \"score\": " << iterations[i].score << ", \"nodes\": " << iterations[i].nodes << ", \"seconds\": " << iterations[i].seconds << '}';
+
+	json << "], \"principal_variation\": [";
+	for (size_t i = 0; i < principalVariation.size(); ++i)
+		json << ((i == 0) ? "" : ", ") << '[' << principalVariation[i] % Board::SideLen << ", " << principalVariation[i] / Board::SideLen << ']';
+	json << "]}";
+
+	return json.str();
+}
 
-	return moves;
+const GameState::Selectivity GameState::DefaultSelectivity = {true, 2, 3, true, 3, 300, true, 3};
+
+GameState::GameState(const Board &b, TranspositionTable *table) : board(b), transpositionTable(table), movesBeforeSearch(b.numSquareOccupied()), history(), pvLengths(), statistics(), hasDeadline(false), stopSignal(nullptr), aborted(false), selectivity(DefaultSelectivity), quiescenceLeft(0), hasPreviousScore(), previousScore()
+{
+	for (auto &moves : killers)
+		moves.fill(TranspositionTable::NoMove);
 }
 
-int GameState::maxValue(int alpha, int beta, Player player, int depth) const
+void GameState::setDeadline(std::chrono::steady_clock::time_point time)
 {
-	if (depth == 1 || terminal())
-		return utility(player);
+	hasDeadline = true;
+	deadline = time;
+}
+
+bool GameState::timeUp()
+{
+	if (!aborted && statistics.nodes % 1024 == 0)
+		aborted = (stopSignal && stopSignal->load(std::memory_order_relaxed)) || (hasDeadline && std::chrono::steady_clock::now() >= deadline);
+
+	return aborted;
+}
+
+void GameState::updatePrincipalVariation(const Coord &move)
+{
+	size_t p = ply();
 
-	int v = INT_MIN;
+	pvTable[p][0] = move.x + move.y * Board::SideLen;
+	pvLengths[p] = 1;
 
-	for (auto const &a : actions())
+	if (p + 1 < MaxPly)
 	{
-		v = std::max(v, result(a).minValue(alpha, beta, player, depth - 1));
-		if (v >= beta)
-			return v;
-		alpha = std::max(alpha, v);
+		std::copy_n(pvTable[p + 1].cbegin(), pvLengths[p + 1], pvTable[p].begin() + 1);
+		pvLengths[p] += pvLengths[p + 1];
 	}
-	return v;
 }
 
-int GameState::minValue(int alpha, int beta, Player player, int depth) const
+std::vector<Square> GameState::getPrincipalVariation() const
 {
-	if (depth == 1 || terminal())
-		return utility(player);
+	std::vector<Square> variation;
+	Player mover = board.getCurrentPlayer();
+
+	for (int move : statistics.principalVariation)
+	{
+		variation.push_back(Square(move % Board::SideLen, move / Board::SideLen, mover));
+		mover = adversaryOf(mover);
+	}
 
-	int v = INT_MAX;
+	return variation;
+}
+
+void GameState::MoveList::pickBest(size_t i)
+{
+	size_t best = i;
 
-	for (auto const &a : actions())
+	for (size_t j = i + 1; j < count; ++j)
 	{
-		v = std::min(v, result(a).maxValue(alpha, beta, player, depth - 1));
-		if (v <= alpha)
-			return v;
-		beta = std::min(beta, v);
+		if (scores[j] > scores[best])
+			best = j;
 	}
-	return v;
+
+	std::swap(moves[i], moves[best]);
+	std::swap(scores[i], scores[best]);
 }
 
-int GameState::minimax(Player player, int depth) const
+int GameState::utility(Player player) const
 {
-	if (depth == 1 || terminal())
+	char status = board.gameStatus();
+
+	if (status == 'd')
+		return 0;
+	else if (status == 'r')
 	{
-		return utility(player);
+		return board.getPatternScore(player) - board.getPatternScore(adversaryOf(player));
 	}
 	else
 	{
-		auto moves = actions();
-		std::vector<int> values;
-		std::transform(moves.cbegin(), moves.cend(), std::back_inserter(values), [this, player, depth](const Coord &move)
-					   { return result(move).minimax(player, depth - 1); });
-		if (board.getCurrentPlayer() == player)
-			return *std::max_element(values.cbegin(), values.cend());
-		else
-			return *std::min_element(values.cbegin(), values.cend());
+		int win = WinScore - int(ply());
+		return (player == ((status == 'x') ? X : O)) ? win : -win;
+	}
+}
+
+GameState::MoveList GameState::actions() const
+{
+	MoveList moves;
+
+	for (int y = 0; y < Board::SideLen; ++y)
+	{
+		for (unsigned row = board.getCandidates()[y]; row != 0; row &= row - 1)
+			moves.push_back(Coord(__builtin_ctz(row), y));
 	}
+
+	return moves;
 }
 
-int GameState::alphaBetaAnalysis(Player player, int depth) const
+int GameState::toTableScore(int score) const
 {
-	if (board.getCurrentPlayer() == player)
-		return maxValue(INT_MIN, INT_MAX, player, depth);
+	if (score > WinScore - MaxPly)
+		return score + int(ply());
+	else if (score < MaxPly - WinScore)
+		return score - int(ply());
 	else
-		return minValue(INT_MIN, INT_MAX, player, depth);
+		return score;
 }
 
-bool Game::placePiece(int x, int y)
+int GameState::fromTableScore(int score) const
 {
-	if (board.coordValid(x, y) && !board.squareOccupied(x, y))
+	if (score > WinScore - MaxPly)
+		return score - int(ply());
+	else if (score < MaxPly - WinScore)
+		return score + int(ply());
+	else
+		return score;
+}
+
+bool GameState::probeTable(int alpha, int beta, int depth, int &score, int &hashMove)
+{
+	hashMove = TranspositionTable::NoMove;
+
+	if (!transpositionTable)
+		return false;
+
+	TranspositionTable::Entry entry;
+	bool found = transpositionTable->probe(board, entry);
+
+	if (Statistics::Detailed)
 	{
-		board.makeMove(x, y);
+		++statistics.tableProbes;
+		statistics.tableHits += found;
+	}
+	if (!found)
+		return false;
 
-		currentPlayer = adversaryOf(currentPlayer);
+	if (entry.getMove() != TranspositionTable::NoMove && !board.squareOccupied(entry.getMove() % Board::SideLen, entry.getMove() / Board::SideLen))
+		hashMove = entry.getMove();
+
+	// At a PV node the search goes on, so that the principal variation runs on through it
+	if (entry.depth < depth || beta - alpha > 1)
+		return false;
 
+	int storedScore = fromTableScore(entry.score);
+	if (entry.bound == TranspositionTable::Exact || (entry.bound == TranspositionTable::LowerBound && storedScore >= beta) || (entry.bound == TranspositionTable::UpperBound && storedScore <= alpha))
+	{
+		score = storedScore;
 		return true;
 	}
+
+	return false;
+}
+
+void GameState::storeTable(int alpha, int beta, int depth, int score, int bestMove)
+{
+	if (!transpositionTable)
+		return;
+
+	if (score <= alpha)
+		transpositionTable->store(board, depth, TranspositionTable::UpperBound, toTableScore(score), bestMove);
+	else if (score >= beta)
+		transpositionTable->store(board, depth, TranspositionTable::LowerBound, toTableScore(score), bestMove);
 	else
-		return false;
+		transpositionTable->store(board, depth, TranspositionTable::Exact, toTableScore(score), bestMove);
 }
 
-bool Game::autoMove()
+GameState::MovePicker::MovePicker(const GameState &s, int hash, bool forcing) : state(s), hashMove(hash), forcingOnly(forcing), stage(HashMove), answering(false), index(0)
 {
-	// Make a very fast opening move
-	if (board.numSquaresOccupiedBy(X) == 0)
+	if (hashMove == TranspositionTable::NoMove)
 	{
-		return placePiece(Board::SideLen / 2, Board::SideLen / 2);
+		findThreats();
+		stage = Wins;
 	}
-	else if (board.numSquaresOccupiedBy(X) == 1)
+}
+
+void GameState::MovePicker::findThreats()
+{
+	const Board &board = state.board;
+	Player mover = board.getCurrentPlayer();
+	bool threeToAnswer = false, fiveToBlock = false;
+	std::array<unsigned, Board::SideLen> answers, fours;
+
+	for (int y = 0; y < Board::SideLen; ++y)
 	{
-		if (!placePiece(Board::SideLen / 2, Board::SideLen / 2))
-			while (!placePiece(Board::SideLen / 2 + rand() % 3 - 1, Board::SideLen / 2 + rand() % 3 - 1))
-				;
+		wins[y] = blocks[y] = rest[y] = forcing[y] = answers[y] = fours[y] = 0;
+
+		for (unsigned row = board.getCandidates()[y]; row != 0; row &= row - 1)
+		{
+			int x = __builtin_ctz(row);
+			unsigned bit = row & -row;
+			ThreatSearch::Threat mine = ThreatSearch::analyse(board, x, y, mover);
+			ThreatSearch::Threat theirs = ThreatSearch::analyse(board, x, y, adversaryOf(mover));
+
+			if (mine.five)
+				wins[y] |= bit;
+			else if (theirs.five)
+			{
+				blocks[y] |= bit;
+				fiveToBlock = true;
+			}
+			else
+				rest[y] |= bit;
+
+			// The adversary has an open three if it could make an open four or two fours at once
+			if (theirs.fours >= 2)
+				threeToAnswer = true;
+			if (mine.fours > 0)
+				fours[y] |= bit;
+			if (mine.fours > 0 || theirs.fours > 0)
+				answers[y] |= bit;
+			if (mine.fours > 0 || mine.numOpenFourSquares > 0 || theirs.fours > 0 || theirs.numOpenFourSquares > 0)
+				forcing[y] |= bit;
+
+			// The hash move counts towards what must be answered, but has been tried already
+			if (x + y * Board::SideLen == hashMove)
+			{
+				wins[y] &= ~bit;
+				blocks[y] &= ~bit;
+				rest[y] &= ~bit;
+			}
+		}
+	}
+
+	for (int y = 0; y < Board::SideLen; ++y)
+	{
+		// Even where the hash move was the block, every other move loses to the five
+		if (fiveToBlock)
+			rest[y] = 0;
+		else if (threeToAnswer)
+			rest[y] &= answers[y];
+		else if (forcingOnly)
+			rest[y] &= fours[y];
+	}
+	answering = fiveToBlock || threeToAnswer;
+}
+
+void GameState::MovePicker::scoreRest()
+{
+	const Board &board = state.board;
+	Player mover = board.getCurrentPlayer();
+	auto &killersHere = state.killers[state.ply()];
+
+	for (int y = 0; y < Board::SideLen; ++y)
+	{
+		for (unsigned row = rest[y]; row != 0; row &= row - 1)
+		{
+			int x = __builtin_ctz(row);
+			int square = x + y * Board::SideLen;
+
+			if (square == killersHere[0])
+				moves.push_back(Coord(x, y), INT_MAX);
+			else if (square == killersHere[1])
+				moves.push_back(Coord(x, y), INT_MAX - 1);
+			else
+				moves.push_back(Coord(x, y), state.history[mover - X][square] + MoveAnalyser(board, x, y, mover).analysisResult() + MoveAnalyser(board, x, y, adversaryOf(mover)).analysisResult());
+		}
+	}
+}
+
+bool GameState::MovePicker::takeFirst(std::array<unsigned, Board::SideLen> &masks, Coord &move)
+{
+	for (int y = 0; y < Board::SideLen; ++y)
+	{
+		if (masks[y] != 0)
+		{
+			move = Coord(__builtin_ctz(masks[y]), y);
+			masks[y] &= masks[y] - 1;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool GameState::MovePicker::next(Coord &move)
+{
+	switch (stage)
+	{
+	case HashMove:
+		stage = Threats;
+		move = Coord(hashMove % Board::SideLen, hashMove / Board::SideLen);
 		return true;
+	case Threats:
+		findThreats();
+		stage = Wins;
+		// fall through
+	case Wins:
+		// One five is as good as any other, and nothing else needs trying
+		if (takeFirst(wins, move))
+		{
+			stage = Done;
+			return true;
+		}
+		stage = Blocks;
+		// fall through
+	case Blocks:
+		// Every move but a block loses to the five at once
+		if (takeFirst(blocks, move))
+		{
+			std::fill(rest.begin(), rest.end(), 0);
+			return true;
+		}
+		scoreRest();
+		stage = Rest;
+		// fall through
+	case Rest:
+		if (index < moves.size())
+		{
+			moves.pickBest(index);
+			move = moves[index++];
+			return true;
+		}
+		stage = Done;
+		// fall through
+	case Done:
+		break;
 	}
-	else
+
+	return false;
+}
+
+void GameState::recordCutoff(const Coord &move, int depth, size_t index)
+{
+	int square = move.x + move.y * Board::SideLen;
+	auto &killersHere = killers[ply()];
+	auto &moversHistory = history[board.getCurrentPlayer() - X];
+
+	++statistics.cutoffs;
+	++statistics.cutoffIndices[std::min(index, size_t(Statistics::CutoffIndices - 1))];
+
+	if (killersHere[0] != square)
 	{
-		int maxScore = INT_MIN;
-		int bestX = 0, bestY = 0;
+		killersHere[1] = killersHere[0];
+		killersHere[0] = square;
+	}
 
-		for (int x = 0; x < Board::SideLen; ++x)
+	moversHistory[square] += depth * depth;
+	if (moversHistory[square] > (1 << 16))
+	{
+		for (auto &h : moversHistory)
+			h /= 2;
+	}
+}
+
+int GameState::negamax(int alpha, int beta, int depth)
+{
+	++statistics.nodes;
+	if (Statistics::Detailed)
+		++statistics.nodesAtPly[ply()];
+	pvLengths[ply()] = 0;
+
+	if (timeUp())
+		return 0;
+
+	// The horizon is no place to stop if the last move threatens, or if the mover's own previous move
+	// still does once blocked: a five or an open four left to play
+	if (terminal() || (depth == 1 && (!selectivity.quiescence || (!moveThreatens(1) && !moveThreatens(2)))))
+	{
+		if (Statistics::Detailed)
+			++statistics.leaves;
+		return utility(board.getCurrentPlayer());
+	}
+
+	if (depth == 1)
+	{
+		quiescenceLeft = selectivity.quiescenceNodes;
+		return quiesce(alpha, beta);
+	}
+
+	// Nothing from here wins sooner than with the next move, or loses sooner than now
+	alpha = std::max(alpha, int(ply()) - WinScore);
+	beta = std::min(beta, WinScore - int(ply()) - 1);
+	if (alpha >= beta)
+		return alpha;
+
+	int best = -Infinity;
+	int hashMove;
+
+	if (probeTable(alpha, beta, depth, best, hashMove))
+		return best;
+
+	const int alphaWhenCalled = alpha;
+	int bestMove = TranspositionTable::NoMove;
+	size_t numSearched = 0;
+
+	// Returns true once there is no need to search further moves
+	auto search = [&](const Coord &a, int reduction)
+	{
+		int score;
+
+		board.makeMove(a.x, a.y);
+		if (numSearched == 0)
+			score = -negamax(-beta, -alpha, depth - 1);
+		else
+		{
+			score = -negamax(-alpha - 1, -alpha, depth - 1 - reduction);
+
+			// A reduced move that beats alpha after all is searched again to full depth
+			if (reduction > 0 && score > alpha && !aborted)
+				score = -negamax(-alpha - 1, -alpha, depth - 1);
+			if (score > alpha && score < beta && !aborted)
+				score = -negamax(-beta, -alpha, depth - 1);
+		}
+		board.unmakeMove();
+
+		if (aborted)
+			return true;
+
+		if (score > best)
+		{
+			best = score;
+			bestMove = a.x + a.y * Board::SideLen;
+		}
+		if (score > alpha)
 		{
-			for (int y = 0; y < Board::SideLen; ++y)
+			alpha = score;
+			updatePrincipalVariation(a);
+		}
+
+		if (alpha >= beta)
+		{
+			recordCutoff(a, depth, numSearched);
+			return true;
+		}
+
+		++numSearched;
+		return false;
+	};
+
+	MovePicker picker(*this, hashMove);
+	Player mover = board.getCurrentPlayer();
+	bool futile = selectivity.futility && depth <= selectivity.futilityDepth;
+	int staticScore = futile ? utility(mover) : 0;
+	auto &killersHere = killers[ply()];
+	Coord a;
+
+	while (picker.next(a))
+	{
+		int square = a.x + a.y * Board::SideLen;
+		int reduction = 0;
+		bool reducible = selectivity.reductions && depth >= selectivity.reductionDepth && numSearched >= size_t(selectivity.fullDepthMoves);
+
+		if (numSearched > 0 && (futile || reducible) && square != killersHere[0] && square != killersHere[1] && !picker.isForcing(a))
+		{
+			if (futile)
 			{
-				if (!board.squareOccupied(x, y) && board.hasOccupiedSquaresNearby(x, y))
+				int optimistic = staticScore + MoveAnalyser(board, a.x, a.y, mover).analysisResult() + MoveAnalyser(board, a.x, a.y, adversaryOf(mover)).analysisResult() + selectivity.futilityMargin * (depth - 1);
+
+				if (optimistic <= alpha)
 				{
-					if (board.terminatingMove(x, y))
-						return placePiece(x, y);
-
-					GameState::numMovesMadeSoFarWhenCalled = board.numSquareOccupied();
-					int score = GameState(board, x, y).alphaBetaAnalysis(currentPlayer, aiDepth);
-					if (score > maxScore)
-					{
-						maxScore = score;
-						bestX = x;
-						bestY = y;
-					}
+					best = std::max(best, optimistic);
+					continue;
 				}
 			}
+
+			if (reducible)
+				reduction = std::min((numSearched >= 3 * size_t(selectivity.fullDepthMoves)) ? 2 : 1, depth - 2);
+		}
+
+		if (search(a, reduction))
+			break;
+	}
+
+	if (!aborted)
+		storeTable(alphaWhenCalled, beta, depth, best, bestMove);
+	return best;
+}
+
+bool GameState::moveThreatens(size_t movesAgo) const
+{
+	if (board.numSquareOccupied() < movesAgo)
+		return false;
+
+	Square move = board.getSquare(board.numSquareOccupied() - movesAgo);
+	ThreatSearch::Threat made = ThreatSearch::analyse(board, move.getX(), move.getY(), move.getPlayer());
+
+	return made.fours > 0 || made.numOpenFourSquares > 0;
+}
+
+int GameState::quiesce(int alpha, int beta)
+{
+	Player mover = board.getCurrentPlayer();
+
+	++statistics.nodes;
+	++statistics.quiescenceNodes;
+	if (Statistics::Detailed)
+		++statistics.nodesAtPly[ply()];
+	pvLengths[ply()] = 0;
+
+	if (timeUp())
+		return 0;
+
+	if (terminal() || quiescenceLeft <= 0 || ply() == MaxPly - 1)
+	{
+		if (Statistics::Detailed)
+			++statistics.leaves;
+		return utility(mover);
+	}
+	--quiescenceLeft;
+
+	MovePicker picker(*this, TranspositionTable::NoMove, true);
+	int best = -Infinity;
+	Coord a;
+
+	if (!picker.mustAnswer())
+	{
+		if (Statistics::Detailed)
+			++statistics.leaves;
+		best = utility(mover);
+		if (best >= beta)
+			return best;
+		alpha = std::max(alpha, best);
+	}
+
+	while (picker.next(a))
+	{
+		board.makeMove(a.x, a.y);
+		int score = -quiesce(-beta, -alpha);
+		board.unmakeMove();
+
+		if (aborted)
+			return 0;
+
+		best = std::max(best, score);
+		if (score > alpha)
+		{
+			alpha = score;
+			updatePrincipalVariation(a);
 		}
+		if (alpha >= beta)
+			break;
+	}
+
+	return best;
+}
 
-		return placePiece(bestX, bestY);
+int GameState::minimax(Player player, int depth)
+{
+	if (depth == 1 || terminal())
+	{
+		return utility(player);
 	}
+	else
+	{
+		auto moves = actions();
+		std::vector<int> values;
+		std::transform(moves.cbegin(), moves.cend(), std::back_inserter(values), [this, player, depth](const Coord &move)
+					   {
+						   board.makeMove(move.x, move.y);
+						   int value = minimax(player, depth - 1);
+						   board.unmakeMove();
+						   return value; });
+		if (board.getCurrentPlayer() == player)
+			return *std::max_element(values.cbegin(), values.cend());
+		else
+			return *std::min_element(values.cbegin(), values.cend());
+	}
+}
+
+int GameState::alphaBetaAnalysis(Player player, int depth)
+{
+	int score = negamax(-Infinity, Infinity, depth);
+	return (board.getCurrentPlayer() == player) ? score : -score;
+}
+
+int GameState::searchRoot(int alpha, int beta, int depth, int &x, int &y)
+{
+	TranspositionTable::Entry entry;
+	int hashMove = (transpositionTable && transpositionTable->probe(board, entry)) ? entry.getMove() : TranspositionTable::NoMove;
+	int best = -Infinity;
+	size_t numSearched = 0;
+
+	if (hashMove != TranspositionTable::NoMove && board.squareOccupied(hashMove % Board::SideLen, hashMove / Board::SideLen))
+		hashMove = TranspositionTable::NoMove;
+
+	x = -1;
+	pvLengths[0] = 0;
+
+	// Nothing beats winning with this move
+	beta = std::min(beta, WinScore - 1);
+
+	// Returns true once there is no need to search further moves.
+	// A reply that refutes this move as well as the best one so far is enough:
+	// the window is bounded below by the best score so far.
+	auto search = [&](const Coord &a)
+	{
+		TRACE_SPAN("root move", a.x + a.y * Board::SideLen);
+		int score;
+
+		board.makeMove(a.x, a.y);
+		if (numSearched == 0)
+			score = -negamax(-beta, -alpha, depth);
+		else
+		{
+			score = -negamax(-alpha - 1, -alpha, depth);
+			if (score > alpha && score < beta && !aborted)
+				score = -negamax(-beta, -alpha, depth);
+		}
+		board.unmakeMove();
+
+		if (aborted)
+			return true;
+
+		if (score > best || x < 0)
+		{
+			best = score;
+			x = a.x;
+			y = a.y;
+		}
+		if (score > alpha)
+		{
+			alpha = score;
+			updatePrincipalVariation(a);
+		}
+
+		++numSearched;
+		return alpha >= beta;
+	};
+
+	// The best move of the previous, shallower search if any, or the one the table ordering prefers,
+	// sets the bound for the others
+	MovePicker picker(*this, hashMove);
+	Coord a;
+
+	while (picker.next(a))
+	{
+		if (search(a))
+			break;
+	}
+
+	return best;
+}
+
+bool GameState::bestMove(int depth, int &x, int &y, int &score)
+{
+	TRACE_SPAN("GameState::bestMove", depth);
+	TranspositionTable::Entry entry;
+	int guess = previousScore[depth % 2];
+	bool hasGuess = hasPreviousScore[depth % 2];
+
+	// This node is searched to depth + 1
+	if (!hasGuess && transpositionTable && transpositionTable->probe(board, entry) && entry.bound == TranspositionTable::Exact && entry.depth % 2 == (depth + 1) % 2)
+	{
+		guess = fromTableScore(entry.score);
+		hasGuess = true;
+	}
+
+	int alpha = -Infinity, beta = Infinity, delta = AspirationWindow;
+	int best, bestX, bestY;
+	uint64_t nodesBefore = statistics.nodes;
+	auto start = std::chrono::steady_clock::now();
+
+	if (hasGuess && !isDecisive(guess))
+	{
+		alpha = std::max(guess - delta, -Infinity);
+		beta = std::min(guess + delta, int(Infinity));
+	}
+
+	while (true)
+	{
+		best = searchRoot(alpha, beta, depth, bestX, bestY);
+
+		if (aborted || bestX < 0)
+			return false;
+
+		if (best <= alpha && alpha > -Infinity)
+			alpha = std::max(alpha - delta, -Infinity);
+		else if (best >= beta && beta < Infinity)
+			beta = std::min(beta + delta, int(Infinity));
+		else
+			break;
+
+		delta = (delta > WinScore / 4) ? int(Infinity) : delta * 4;
+	}
+
+	// Searching the children to depth is searching this node to depth + 1
+	storeTable(alpha, beta, depth + 1, best, bestX + bestY * Board::SideLen);
+	statistics.principalVariation.assign(pvTable[0].cbegin(), pvTable[0].cbegin() + pvLengths[0]);
+	statistics.iterations.push_back(Statistics::Iteration{depth, best, statistics.nodes - nodesBefore, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()});
+	hasPreviousScore[depth % 2] = true;
+	previousScore[depth % 2] = best;
+	x = bestX;
+	y = bestY;
+	score = best;
+	return true;
+}
+
+void GameState::deepen(int firstDepth)
+{
+	int x, y, score;
+
+	for (int depth = firstDepth; depth < std::min(Board::NumSquares - int(board.numSquareOccupied()), int(MaxPly) - 1); ++depth)
+	{
+		if (!bestMove(depth, x, y, score))
+			break;
+	}
+}
+
+bool Game::placePiece(int x, int y)
+{
+	if (board.coordValid(x, y) && !board.squareOccupied(x, y))
+	{
+		board.makeMove(x, y);
+
+		currentPlayer = adversaryOf(currentPlayer);
+
+		return true;
+	}
+	else
+		return false;
+}
+
+int Game::chooseMove()
+{
+	TRACE_SPAN("Game::chooseMove");
+	principalVariation.clear();
+	searchStatistics = GameState::Statistics();
+
+	int bookMove = book.probe(board, random);
+
+	if (bookMove != TranspositionTable::NoMove)
+	{
+		searchDepth = 0;
+		searchStatistics.principalVariation.push_back(bookMove);
+		principalVariation.push_back(Square(bookMove % Board::SideLen, bookMove / Board::SideLen, board.getCurrentPlayer()));
+		return bookMove;
+	}
+	else if (board.numSquareOccupied() == 0)
+	{
+		// Without a book, there is nothing to search on an empty board
+		return Board::SideLen / 2 + Board::SideLen / 2 * Board::SideLen;
+	}
+	else
+	{
+		// A win forced by fours, or by fours and threes, needs no full-width search
+		ThreatSearch threats(board);
+		int win = threats.findWin(VcfDepth, false);
+
+		if (win == TranspositionTable::NoMove)
+			win = threats.findWin(VctDepth, true);
+
+		// Proof-number search follows the threats further where they branch
+		ProofSearch proof(board, ProofNodes, ProofTableSize);
+
+		if (win == TranspositionTable::NoMove && proof.solve() == ProofSearch::Proven)
+			win = proof.getWinningMove();
+
+		if (win != TranspositionTable::NoMove)
+		{
+			searchDepth = 0;
+			searchStatistics.nodes = threats.getNodes() + proof.getNodes();
+			searchStatistics.principalVariation.push_back(win);
+			principalVariation.push_back(Square(win % Board::SideLen, win / Board::SideLen, board.getCurrentPlayer()));
+			return win;
+		}
+
+		std::unique_ptr<GameState> state;
+		int bestX = 0, bestY = 0, score = 0, depth = 0;
+
+		// Carry on where the ponder search of this very position stopped
+		if (ponderState && ponderKey == board.getKey())
+		{
+			state = std::move(ponderState);
+			state->clearAbort();
+			// The ponder search ran on the opponent's time, so its nodes are not this move's
+			state->resetStatistics();
+			depth = ponderDepth;
+			bestX = ponderBestMove % Board::SideLen;
+			bestY = ponderBestMove / Board::SideLen;
+			score = ponderScore;
+		}
+		else
+			state.reset(new GameState(board, &transpositionTable));
+
+		ponderState.reset();
+		state->setStopSignal(&cancelled);
+		state->setSelectivity(selectivity);
+
+		// Lazy SMP: helpers search the same position on their own boards, half of them a ply ahead,
+		// and pass on what they find only through the shared transposition table
+		std::atomic<bool> stop(false);
+		std::vector<std::unique_ptr<GameState>> helpers;
+		std::vector<std::thread> threads;
+
+		for (int i = 1; i < numThreads; ++i)
+		{
+			helpers.emplace_back(new GameState(board, &transpositionTable));
+			helpers.back()->setStopSignal(&stop);
+			helpers.back()->setSelectivity(selectivity);
+			threads.emplace_back(&GameState::deepen, helpers.back().get(), 1 + i % 2);
+		}
+
+		if (timeLimit > 0)
+		{
+			auto start = std::chrono::steady_clock::now();
+
+			// Depth 1 is never interrupted, so that there is always a move to play
+			if (depth == 0 && state->bestMove(1, bestX, bestY, score))
+				depth = 1;
+			state->setDeadline(start + std::chrono::milliseconds(timeLimit));
+
+			// Each iteration starts from the moves the previous ones found best, through the
+			// transposition table, killers and history. Stop once the result is a forced win or loss.
+			while (!GameState::isDecisive(score) && depth < std::min(Board::NumSquares - int(board.numSquareOccupied()), int(GameState::MaxPly) - 1) && state->bestMove(depth + 1, bestX, bestY, score))
+				++depth;
+		}
+		else
+		{
+			// Deepening to aiDepth costs less than going there at once, for the moves the shallower
+			// iterations leave in the table
+			while (depth < aiDepth && !(depth > 0 && GameState::isDecisive(score)) && state->bestMove(depth + 1, bestX, bestY, score))
+				++depth;
+		}
+
+		stop = true;
+		for (auto &thread : threads)
+			thread.join();
+
+		searchDepth = depth;
+		searchStatistics = state->getStatistics();
+		for (auto const &helper : helpers)
+			searchStatistics += helper->getStatistics();
+
+		if (cancelled)
+			return TranspositionTable::NoMove;
+
+		principalVariation = state->getPrincipalVariation();
+		return bestX + bestY * Board::SideLen;
+	}
+}
+
+bool Game::makeMove(int x, int y)
+{
+	cancelAutoMove();
+	stopPondering();
+
+	// The ponder search is of no use after an unexpected reply
+	if (x + y * Board::SideLen != expectedReply)
+		ponderState.reset();
+
+	return placePiece(x, y);
+}
+
+bool Game::autoMove()
+{
+	TRACE_SPAN("Game::autoMove");
+	cancelAutoMove();
+	stopPondering();
+
+	int move = chooseMove();
+	if (move == TranspositionTable::NoMove || !placePiece(move % Board::SideLen, move / Board::SideLen))
+		return false;
+
+	startPondering();
+	return true;
+}
+
+void Game::startAutoMove()
+{
+	cancelAutoMove();
+	stopPondering();
+	pendingMove = std::async(std::launch::async, &Game::chooseMove, this);
+}
+
+bool Game::pollAutoMove()
+{
+	if (!pendingMove.valid() || thinking())
+		return false;
+
+	int move = pendingMove.get();
+	if (move == TranspositionTable::NoMove || !placePiece(move % Board::SideLen, move / Board::SideLen))
+		return false;
+
+	startPondering();
+	return true;
+}
+
+void Game::undo()
+{
+	cancelAutoMove();
+	stopPondering();
+	ponderState.reset();
+	board.undo();
+}
+
+void Game::setPondering(bool enabled)
+{
+	pondering = enabled;
+
+	if (!pondering)
+	{
+		stopPondering();
+		ponderState.reset();
+	}
+}
+
+void Game::startPondering()
+{
+	ponderState.reset();
+	expectedReply = TranspositionTable::NoMove;
+
+	if (!pondering || board.gameStatus() != 'r')
+		return;
+
+	// Where the principal variation ends at the move played, the table may still have a reply
+	int reply = TranspositionTable::NoMove;
+	TranspositionTable::Entry entry;
+
+	if (principalVariation.size() >= 2)
+		reply = principalVariation[1].getX() + principalVariation[1].getY() * Board::SideLen;
+	else if (transpositionTable.probe(board, entry) && entry.getMove() != TranspositionTable::NoMove && !board.squareOccupied(entry.getMove() % Board::SideLen, entry.getMove() / Board::SideLen))
+		reply = entry.getMove();
+
+	if (reply == TranspositionTable::NoMove)
+		return;
+
+	Board expected(board, reply % Board::SideLen, reply / Board::SideLen);
+	if (expected.gameStatus() != 'r')
+		return;
+
+	expectedReply = reply;
+	ponderKey = expected.getKey();
+	ponderState.reset(new GameState(expected, &transpositionTable));
+	ponderState->setStopSignal(&stopPonderSearch);
+	ponderState->setSelectivity(selectivity);
+	ponderDepth = 0;
+
+	int maxDepth = std::min(Board::NumSquares - int(expected.numSquareOccupied()), int(GameState::MaxPly) - 1);
+
+	ponderSearch = std::async(std::launch::async, &Game::ponder, this, maxDepth);
+}
+
+void Game::ponder(int maxDepth)
+{
+	TRACE_SPAN("Game::ponder");
+	int x, y, score = 0;
+
+	while (!GameState::isDecisive(score) && ponderDepth < maxDepth && ponderState->bestMove(ponderDepth + 1, x, y, score))
+	{
+		++ponderDepth;
+		ponderBestMove = x + y * Board::SideLen;
+		ponderScore = score;
+	}
+}
+
+void Game::stopPondering()
+{
+	if (ponderSearch.valid())
+	{
+		stopPonderSearch = true;
+		ponderSearch.get();
+	}
+
+	stopPonderSearch = false;
+}
+
+void Game::cancelAutoMove()
+{
+	if (pendingMove.valid())
+	{
+		cancelled = true;
+		pendingMove.get();
+	}
+
+	cancelled = false;
 }
 
 void Game::restart()
 {
+	cancelAutoMove();
+	stopPondering();
+	ponderState.reset();
 	board.clear();
 	currentPlayer = X;
 }
@@ -1,10 +1,25 @@
 #ifndef GAME_H_
 #define GAME_H_
 
+#include "book.h"
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <random>
 #include <vector>
 #include <string>
 
+/**
+ * Set to 1 to count the detailed search statistics (see GameState::Statistics).
+ */
+#ifndef WOO_STATISTICS
+#define WOO_STATISTICS 0
+#endif
+
 enum Player
 {
 	Nobody,
@@ -13,7 +28,10 @@ enum Player
 	Invalid
 };
 
-inline Player adversaryOf(const Player);
+inline Player adversaryOf(const Player p)
+{
+	return ((p == X) ? O : X);
+}
 
 class Square
 {
@@ -51,42 +69,188 @@ class Board
 public:
 	enum
 	{
-		SideLen = 15
+		SideLen = 15,
+		NumSquares = SideLen * SideLen,
+
+		/**
+		 * Rotations and reflections of the board, numbered as by transformSquare.
+		 */
+		NumSymmetries = 8,
+
+		/**
+		 * Largest candidate radius, for which the 2 * radius + 1 squares around one still fit in a line.
+		 */
+		MaxCandidateRadius = 7
 	};
 
 private:
-	std::array<Square, SideLen * SideLen> squares;
-	std::vector<Square> occupiedSquares;
+	enum
+	{
+		NumDiagonals = 2 * SideLen - 1,
+		NumLines = 2 * SideLen + 2 * NumDiagonals
+	};
 
-public:
-	Square *mostRecentlyModifiedSquare;
+	/**
+	 * One bit-plane per player (X first, then O) per row, column, diagonal
+	 * and anti-diagonal: bit i of a line is the i-th square along it.
+	 */
+	std::array<std::array<uint16_t, NumLines>, 2> lines;
 
-private:
-	static const int Directions[4][2];
+	/**
+	 * Occupied squares (x + y * SideLen) in the order they were played.
+	 */
+	std::array<uint8_t, NumSquares> moves;
+	int numMoves;
+
+	/**
+	 * Zobrist keys of the position under each symmetry, updated incrementally as moves are made and unmade:
+	 * keys[t] is the key of the position transformed by t, so keys[0] is the key of the position itself.
+	 * The side to move follows from the number of pieces and needs no key of its own.
+	 */
+	std::array<uint64_t, NumSymmetries> keys;
+
+	/**
+	 * MoveAnalyser::scoreOfLine of every line from each player's point of view, and their sums.
+	 * Only the four lines through a square change when it does.
+	 */
+	std::array<std::array<int, NumLines>, 2> lineScores;
+	std::array<int, 2> patternScores;
+
+	/**
+	 * Unoccupied squares with a piece within candidateRadius in one of the eight directions,
+	 * one word per row with bit x for column x.
+	 */
+	std::array<uint16_t, SideLen> candidates;
+	int candidateRadius;
+
+	/**
+	 * One random key per player per square.
+	 */
+	static const std::array<std::array<uint64_t, NumSquares>, 2> ZobristKeys;
+
+	/**
+	 * For each player and square, the keys of the squares each symmetry takes it to,
+	 * all eight in one cache line.
+	 */
+	static const std::array<std::array<std::array<uint64_t, NumSymmetries>, NumSquares>, 2> SymmetricKeys;
+
+	/**
+	 * The square each symmetry takes each square to, and the symmetry that undoes each.
+	 */
+	static const std::array<std::array<uint8_t, NumSquares>, NumSymmetries> Symmetries;
+	static const std::array<int, NumSymmetries> InverseSymmetries;
+
+	/**
+	 * The squares that actually exist on each line.
+	 */
+	static const std::array<uint16_t, NumLines> LineMasks;
+
+	static int lineOf(size_t direction, int x, int y);
+	static int positionOf(size_t direction, int x, int y) { return (direction == 1) ? y : x; }
+
+	/**
+	 * The nine squares of a line centred on position, bit 0 being position - 4.
+	 */
+	static unsigned windowOf(uint16_t line, int position) { return ((unsigned(line) << 4) >> position) & 0x1FF; }
+
+	void setOccupant(int x, int y, Player);
+	void updateLineScores(int x, int y);
+
+	/**
+	 * Make the unoccupied neighbourhood of (x, y) candidates, and (x, y) itself not.
+	 */
+	void addCandidates(int x, int y);
+
+	/**
+	 * Recompute the candidates of the rows within candidateRadius of row y
+	 * by spreading each occupied square over its neighbourhood.
+	 */
+	void updateCandidates(int y);
 
 	inline bool draw() const;
 
 public:
+	/**
+	 * One step along a row, column, diagonal and anti-diagonal, in the order of getSurroundingStrips.
+	 */
+	static const int Directions[4][2];
+
 	Board();
-	Board(const Board &other);
 	Board(const Board &other, int moveX, int moveY);
 	~Board() {}
 
-	const Board &operator=(const Board &other);
-
-	Square &getSquare(int x, int y) { return squares.at(x + y * SideLen); }
-	const Square &getSquare(int x, int y) const { return squares.at(x + y * SideLen); }
-	const Square &getSquare(size_t moveIndex) const { return occupiedSquares.at(moveIndex); }
+	Square getSquare(int x, int y) const;
+	Square getSquare(size_t moveIndex) const { return getSquare(moves.at(moveIndex) % SideLen, moves.at(moveIndex) / SideLen); }
+	Square getMostRecentlyModifiedSquare() const { return getSquare(numMoves - 1); }
 	bool coordValid(int x, int y) const { return (x >= 0 && x < SideLen && y >= 0 && y < SideLen); }
-	bool squareOccupied(int x, int y) const { return (getSquare(x, y).getPlayer() != Nobody); }
+	bool squareOccupied(int x, int y) const { return ((lines[0][y] | lines[1][y]) >> x) & 1; }
+
+	uint64_t getKey() const { return keys[0]; }
+
+	/**
+	 * The symmetry that takes the position to its canonical form, the one of its eight rotations and reflections
+	 * with the least key, and that key. Positions that are rotations or reflections of each other
+	 * have the same canonical key, and a move m of one is transformSquare(getCanonicalTransform(), m) in the canonical form.
+	 */
+	int getCanonicalTransform() const { return int(std::min_element(keys.begin(), keys.end()) - keys.begin()); }
+	uint64_t getCanonicalKey() const { return *std::min_element(keys.begin(), keys.end()); }
+
+	/**
+	 * The key of the position transformed by a symmetry.
+	 */
+	uint64_t getSymmetricKey(int transform) const { return keys[transform]; }
+
+	/**
+	 * The canonical key the position would have after the player to move played at (x, y).
+	 */
+	uint64_t getCanonicalKeyAfter(int x, int y) const;
+
+	/**
+	 * The square (x + y * SideLen) a symmetry takes square to. Bit 2 of transform swaps x and y,
+	 * then bit 0 reflects x and bit 1 reflects y; 0 leaves the board as it is.
+	 */
+	static int transformSquare(int transform, int square) { return Symmetries[transform][square]; }
+	static int inverseTransform(int transform) { return InverseSymmetries[transform]; }
+
+	/**
+	 * Sum of the pattern scores of the player over all lines of the board.
+	 */
+	int getPatternScore(Player player) const { return patternScores[player - X]; }
 
-	inline size_t numSquareOccupied() const { return occupiedSquares.size(); }
+	inline size_t numSquareOccupied() const { return numMoves; }
 	inline int numSquaresOccupiedBy(Player) const;
-	inline Player getCurrentPlayer() const;
+	Player getCurrentPlayer() const { return ((numMoves % 2 == 1) ? O : X); }
 	std::array<PieceStrip, 4 /* Num of directions */> getSurroundingPieces(int x, int y) const;
+
+	/**
+	 * The same four strips encoded as MoveAnalyser table indices from the point of view of player:
+	 * bits 9-17 mark the player's pieces, bits 0-8 the adversary's and squares off the board carry both.
+	 * Bit 4 (and 13) is (x, y); strip index i is bit 8 - i.
+	 */
+	std::array<unsigned, 4> getSurroundingStrips(int x, int y, Player player) const;
 	bool hasOccupiedSquaresNearby(int x, int y) const;
 
+	/**
+	 * The unoccupied squares with occupied squares nearby, as row masks: bit x of word y is (x, y).
+	 */
+	const std::array<uint16_t, SideLen> &getCandidates() const { return candidates; }
+	int getCandidateRadius() const { return candidateRadius; }
+
+	/**
+	 * Clamped to 1 to MaxCandidateRadius, since with no candidates no move could be searched.
+	 */
+	void setCandidateRadius(int radius);
+
 	void makeMove(int x, int y);
+
+	/**
+	 * Take back the most recent move only.
+	 */
+	void unmakeMove();
+
+	/**
+	 * Take back the last two moves, i.e. one turn of each player.
+	 */
 	void undo();
 
 	/**
@@ -107,14 +271,25 @@ public:
 class MoveAnalyser
 {
 private:
-	Player evaluatedPlayer;
-	std::array<PieceStrip, 4 /* Num of directions */> analysedStrips;
+	std::array<unsigned, 4 /* Num of directions */> analysedStrips;
 
 	static const std::array<const std::string, 22> Patterns;
-	int scoreOfPattern(size_t patternSubscript) const;
+	static int scoreOfPattern(size_t patternSubscript);
 
-	/** Return score for match */
-	int getScoreOfStrip(const PieceStrip &) const;
+	/** Return score for match, by matching the strip against every pattern */
+	static int getScoreOfStrip(const PieceStrip &, Player evaluatedPlayer);
+
+	/**
+	 * getScoreOfStrip for every encoded strip (see Board::getSurroundingStrips),
+	 * computed once at startup.
+	 */
+	static const std::vector<int> StripScores;
+
+	/**
+	 * Score of the patterns, read in either direction, that start at the first of seven squares.
+	 * Indexed like StripScores: bits 7-13 for the player, bits 0-6 for the adversary, bit 0 and 7 first.
+	 */
+	static const std::vector<int> PatternStartScores;
 
 public:
 	/**
@@ -130,6 +305,83 @@ public:
 	~MoveAnalyser() {}
 
 	int analysisResult() const;
+
+	/**
+	 * Score of every pattern, read in either direction, along a whole line.
+	 * Bit i of mine and adversarys is the i-th square of the line; squares off the board are set in both.
+	 */
+	static int scoreOfLine(unsigned mine, unsigned adversarys);
+};
+
+/**
+ * A fixed-size hash table of search results indexed by Board::getCanonicalKey(),
+ * so that positions that are rotations or reflections of each other share their entry.
+ * A slot is overwritten by a different position, or by a search of the same one at least as deep.
+ * Every search thread reads and writes it without locks.
+ */
+class TranspositionTable
+{
+public:
+	enum Bound
+	{
+		Exact,
+		LowerBound,
+		UpperBound
+	};
+
+	enum
+	{
+		NoMove = -1
+	};
+
+	struct Entry
+	{
+		uint64_t key;
+		int score;
+		int8_t depth;
+		uint8_t bound;
+		uint8_t move; // x + y * Board::SideLen, or UINT8_MAX if none
+
+		int getMove() const { return (move == UINT8_MAX) ? NoMove : move; }
+	};
+
+private:
+	/**
+	 * An entry packed into one word, stored next to the key xor-ed with that word.
+	 * A slot torn by two threads writing it at once then matches neither key.
+	 */
+	struct Slot
+	{
+		std::atomic<uint64_t> check;
+		std::atomic<uint64_t> data;
+	};
+
+	std::vector<Slot> slots;
+
+	static uint64_t pack(const Entry &);
+	static Entry unpack(uint64_t key, uint64_t data);
+
+	bool probe(uint64_t key, Entry &) const;
+	void store(uint64_t key, int depth, Bound, int score, int move);
+
+public:
+	TranspositionTable(size_t megabytes = 16) { resize(megabytes); }
+	~TranspositionTable() {}
+
+	/**
+	 * Reallocate the table to the largest power-of-two number of entries
+	 * that fits in the given size. This discards all entries.
+	 */
+	void resize(size_t megabytes);
+	void clear();
+
+	/**
+	 * Copy the entry stored for the position into entry and return true, or return false if there is none.
+	 * The entry may have been stored for a rotation or reflection of the position; its move is then
+	 * the corresponding move of this one.
+	 */
+	bool probe(const Board &, Entry &entry) const;
+	void store(const Board &, int depth, Bound, int score, int move);
 };
 
 /**
@@ -140,57 +392,459 @@ public:
  * 		Utility(s, p) if Terminal(s) or depth = 1
  * 		max(Minimax(Result(s, a), p, depth - 1)) for each a in Actions(s) if Player(s) = p
  * 		min(Minimax(Result(s, a), p, depth - 1)) for each a in Actions(s) if Player(s) is not p
+ *
+ * The search itself takes the negamax form: every score is from the point of view of the player to move,
+ * and the value of a node is the greatest negated value of its children.
  */
 class GameState
 {
+public:
+	/**
+	 * A win n plies after the root of the search scores WinScore - n, and a loss the negation,
+	 * so that quicker wins and slower losses are preferred. Every score lies strictly
+	 * between -Infinity and Infinity, so any can be negated.
+	 */
+	enum
+	{
+		MaxPly = 64,
+		WinScore = 1000000000,
+		Infinity = WinScore + 1
+	};
+
+	static bool isDecisive(int score) { return score > WinScore - MaxPly || score < MaxPly - WinScore; }
+
+	/**
+	 * How selective the search is. Only quiet moves, which neither make nor stop a four or an open three,
+	 * are reduced or pruned, and never the first move of a node or a killer.
+	 * With all of it turned off, the search is full-width alpha-beta to a fixed depth.
+	 */
+	struct Selectivity
+	{
+		/**
+		 * Late move reductions: after fullDepthMoves moves, the quiet moves of a node at least reductionDepth deep
+		 * are searched a ply shallower, two plies if later still, and to full depth again only if they beat alpha.
+		 */
+		bool reductions;
+		int fullDepthMoves;
+		int reductionDepth;
+
+		/**
+		 * Futility pruning: at nodes at most futilityDepth deep, a quiet move is skipped if the static score
+		 * plus its MoveAnalyser scores plus futilityMargin per ply left still does not reach alpha.
+		 */
+		bool futility;
+		int futilityDepth;
+		int futilityMargin;
+
+		/**
+		 * Quiescence search: at the horizon, the mover's fives and fours, the blocks of the adversary's fives
+		 * and the answers to its open threes are searched until the position is quiet,
+		 * at most quiescenceNodes nodes below each horizon node.
+		 */
+		bool quiescence;
+		int quiescenceNodes;
+	};
+
+	static const Selectivity DefaultSelectivity;
+
 private:
 	struct Coord
 	{
 		int x;
 		int y;
 
-		Coord(int p = 0, int q = 0) : x(p), y(q) {}
+		Coord() = default;
+		Coord(int p, int q) : x(p), y(q) {}
+	};
+
+	/**
+	 * A list of moves with room for every square, so that generating moves never allocates.
+	 */
+	class MoveList
+	{
+	private:
+		std::array<Coord, Board::NumSquares> moves;
+		std::array<int, Board::NumSquares> scores;
+		size_t count;
+
+	public:
+		MoveList() : count(0) {}
+
+		void push_back(const Coord &move, int score = 0)
+		{
+			moves[count] = move;
+			scores[count++] = score;
+		}
+		size_t size() const { return count; }
+
+		/**
+		 * Swap the highest scored of the moves from i onwards into i,
+		 * so that a cutoff saves sorting the rest.
+		 */
+		void pickBest(size_t i);
+
+		Coord &operator[](size_t i) { return moves[i]; }
+		const Coord *begin() const { return moves.data(); }
+		const Coord *end() const { return moves.data() + count; }
+		const Coord *cbegin() const { return begin(); }
+		const Coord *cend() const { return end(); }
 	};
 
 	Board board;
 
-	bool terminal() const { return board.gameStatus() != 'r'; }
+	TranspositionTable *transpositionTable;
+
+	/**
+	 * Number of moves on the board when the search began, to tell the ply of a node.
+	 */
+	size_t movesBeforeSearch;
+
+	/**
+	 * Two moves per ply that most recently caused a cutoff there.
+	 */
+	std::array<std::array<int, 2>, MaxPly> killers;
+
+	/**
+	 * Per player and square, the sum of depth squared of the cutoffs it caused.
+	 */
+	std::array<std::array<int, Board::NumSquares>, 2> history;
+
+	/**
+	 * Triangular table of principal variations: row p holds the best line found
+	 * from the node at ply p, pvLengths[p] moves long.
+	 */
+	std::array<std::array<int, MaxPly>, MaxPly> pvTable;
+	std::array<size_t, MaxPly> pvLengths;
+
+	size_t ply() const { return std::min(board.numSquareOccupied() - movesBeforeSearch, size_t(MaxPly - 1)); }
+
+	/**
+	 * Make move followed by the principal variation of the ply below that of the current node.
+	 */
+	void updatePrincipalVariation(const Coord &move);
+
+public:
+	/**
+	 * What the searches run on a state did. Nodes, cutoffs, iterations and the principal variation
+	 * are always recorded; the counters marked detailed only if built with WOO_STATISTICS set,
+	 * as counting them costs time in the innermost loops. Otherwise they stay zero.
+	 */
+	struct Statistics
+	{
+		static constexpr bool Detailed = WOO_STATISTICS;
+
+		enum
+		{
+			CutoffIndices = 8
+		};
+
+		uint64_t nodes;
+		uint64_t quiescenceNodes; // nodes, of those, searched by quiesce
+		uint64_t cutoffs;
+
+		/**
+		 * Cutoffs by the index of the move that caused them among those searched, the last counting the rest.
+		 * A large share at index 0 means good move ordering.
+		 */
+		std::array<uint64_t, CutoffIndices> cutoffIndices;
+
+		/**
+		 * Detailed: static evaluations, transposition table lookups and those that found the position,
+		 * and nodes by ply from the root.
+		 */
+		uint64_t leaves;
+		uint64_t tableProbes;
+		uint64_t tableHits;
+		std::array<uint64_t, MaxPly> nodesAtPly;
+
+		/**
+		 * Every bestMove that finished: its depth, score, nodes and time.
+		 */
+		struct Iteration
+		{
+			int depth;
+			int score;
+			uint64_t nodes;
+			double seconds;
+		};
+
+		std::vector<Iteration> iterations;
+
+		/**
+		 * The principal variation of the last iteration, as x + y * Board::SideLen.
+		 */
+		std::vector<int> principalVariation;
+
+		Statistics() : nodes(0), quiescenceNodes(0), cutoffs(0), cutoffIndices(), leaves(0), tableProbes(0), tableHits(0), nodesAtPly() {}
 
-	int recentMovesAnalysisResult(Player) const;
+		/**
+		 * Add the counters of another thread's search; the iterations and principal variation stay this one's.
+		 */
+		Statistics &operator+=(const Statistics &other);
 
+		/**
+		 * Nodes of the last iteration over those of the one before, or 0 with fewer than two iterations.
+		 */
+		double effectiveBranchingFactor() const;
+
+		/**
+		 * Share of transposition table lookups that found the position, or 0 if none were counted.
+		 */
+		double tableHitRate() const;
+
+		std::string toJson() const;
+	};
+
+private:
+	Statistics statistics;
+
+	bool hasDeadline;
+	std::chrono::steady_clock::time_point deadline;
+
+	/**
+	 * Another thread sets this to abandon the search.
+	 */
+	const std::atomic<bool> *stopSignal;
+
+	/**
+	 * Set once the deadline has passed. Every node then returns at once
+	 * with a meaningless score, which is neither stored nor used.
+	 */
+	bool aborted;
+
+	/**
+	 * Look at the clock and the stop signal every so many nodes,
+	 * and set aborted if the deadline has passed or a stop was signalled.
+	 */
+	bool timeUp();
+
+	bool terminal() const { return board.gameStatus() != 'r'; }
+
+	/**
+	 * Pattern scores of the whole board for player minus those of the adversary,
+	 * or the score of a win or a loss.
+	 */
 	int utility(Player) const;
 
 	/**
-	 * Takes the current state and a particular move (Coord)
-	 * Returns the resulting state.
+	 * Returns the moves worth considering in this state,
+	 * i.e. the board's candidates: unoccupied squares with a piece
+	 * within the candidate radius in one of the eight directions.
+	 */
+	MoveList actions() const;
+
+	/**
+	 * Hands out the moves of a node in stages, so that a cutoff saves generating the later ones:
+	 * the hash move, the mover's five, the blocks of the adversary's fives, then the rest.
+	 * Under a five or an open three of the adversary, the rest are only the moves that answer it:
+	 * the squares the adversary could make a four on, and the mover's own fours.
+	 * If forcingOnly, the rest are otherwise only the mover's fours.
+	 */
+	class MovePicker
+	{
+	private:
+		enum Stage
+		{
+			HashMove,
+			Threats,
+			Wins,
+			Blocks,
+			Rest,
+			Done
+		};
+
+		const GameState &state;
+		int hashMove;
+		bool forcingOnly;
+		Stage stage;
+		bool answering;
+
+		/**
+		 * Row masks like Board::getCandidates: the mover's fives, the adversary's,
+		 * the squares the rest are taken from, and the forcing squares.
+		 */
+		std::array<unsigned, Board::SideLen> wins;
+		std::array<unsigned, Board::SideLen> blocks;
+		std::array<unsigned, Board::SideLen> rest;
+		std::array<unsigned, Board::SideLen> forcing;
+
+		/**
+		 * The rest, scored for MoveList::pickBest: killer moves of this ply first,
+		 * then by history plus the static MoveAnalyser score of the square for either player.
+		 */
+		MoveList moves;
+		size_t index;
+
+		/**
+		 * Classify every candidate by what it makes for either player.
+		 */
+		void findThreats();
+
+		/**
+		 * Fill moves from rest.
+		 */
+		void scoreRest();
+
+		/**
+		 * Take the first square of masks, if any, out of it.
+		 */
+		static bool takeFirst(std::array<unsigned, Board::SideLen> &masks, Coord &move);
+
+	public:
+		MovePicker(const GameState &s, int hash, bool forcing = false);
+
+		/**
+		 * Set move to the next move to try and return true, or return false once there are none left.
+		 */
+		bool next(Coord &move);
+
+		/**
+		 * Whether a move after the hash move makes or stops a five, a four or an open three.
+		 */
+		bool isForcing(const Coord &move) const { return (forcing[move.y] >> move.x) & 1; }
+
+		/**
+		 * Whether the adversary threatens five or has an open three, so that the mover cannot stand pat.
+		 * Known once the hash move, if any, has been handed out.
+		 */
+		bool mustAnswer() const { return answering; }
+	};
+
+	/**
+	 * Update the counters, killers and history after moves[index] caused a cutoff.
+	 */
+	void recordCutoff(const Coord &move, int depth, size_t index);
+
+	/**
+	 * Only quiet moves, which MovePicker::isForcing tells apart, are reduced or pruned.
+	 */
+	Selectivity selectivity;
+
+	/**
+	 * The table holds wins and losses counted in plies from the node rather than from the root,
+	 * so that they stay valid wherever the node is met again. These convert to and from that.
+	 */
+	int toTableScore(int score) const;
+	int fromTableScore(int score) const;
+
+	/**
+	 * Return true with score set if the table already decides this node for the null window;
+	 * otherwise set hashMove to the best move stored for it, if any.
+	 */
+	bool probeTable(int alpha, int beta, int depth, int &score, int &hashMove);
+	void storeTable(int alpha, int beta, int depth, int score, int bestMove);
+
+	/**
+	 * Alpha-beta search of the current node to depth plies, from the point of view of the player to move.
+	 * Children are searched in place: each move is made on the board and unmade afterwards.
+	 * Only the first is searched with the full window (principal variation search); the others
+	 * are searched with a null window to show they are no better, and again in full if they are.
+	 */
+	int negamax(int alpha, int beta, int depth);
+
+	/**
+	 * Whether the move made movesAgo moves ago (1 for the last) makes a four or an open three
+	 * on the board as it is now.
+	 */
+	bool moveThreatens(size_t movesAgo) const;
+
+	/**
+	 * Nodes quiesce may still visit below the current horizon node.
 	 */
-	inline GameState result(const Coord &move) const;
+	int quiescenceLeft;
 
 	/**
-	 * Returns a vector of legal moves in this state,
-	 * i.e. Unoccupied Squares
-	 *
-	 * I am going to optimise this method
-	 * by only returning those coordinates with occupied squares nearby,
-	 * that is, if an unoccupied square does not have a piece within two squares
-	 * in all four directions, then this would not be included in the returned vector.
-	 * This calls for a helper function.
+	 * Search of the forcing moves below the horizon, from the point of view of the player to move.
+	 * The mover may stand pat on the static score unless it has to answer a threat.
 	 */
-	std::vector<Coord> actions() const;
+	int quiesce(int alpha, int beta);
 
-	// These two below are for alpha-beta pruning
-	int maxValue(int alpha, int beta, Player, int depth) const;
-	int minValue(int alpla, int beta, Player, int depth) const;
+	/**
+	 * The root of negamax: search the children of the current node to depth plies within the window
+	 * and set x and y to the best move. Return the best score, or a bound on it outside the window.
+	 */
+	int searchRoot(int alpha, int beta, int depth, int &x, int &y);
+
+	/**
+	 * Half the width of the first window bestMove searches around the previous score,
+	 * which grows fourfold each time the score falls outside it.
+	 */
+	enum
+	{
+		AspirationWindow = 100
+	};
+
+	/**
+	 * The score of the last bestMove that finished to an odd and to an even depth, to centre the next
+	 * window on: the static scores after the player's own move and after the adversary's differ widely.
+	 */
+	std::array<bool, 2> hasPreviousScore;
+	std::array<int, 2> previousScore;
 
 public:
-	GameState(const Board &b) : board(b) {}
-	GameState(const Board &b, int moveX, int moveY);
+	GameState(const Board &b, TranspositionTable *table = nullptr);
 	~GameState() {}
 
-	static size_t numMovesMadeSoFarWhenCalled;
+	void makeMove(int x, int y) { board.makeMove(x, y); }
+	void unmakeMove() { board.unmakeMove(); }
+
+	/**
+	 * Abandon any search still running at time.
+	 */
+	void setDeadline(std::chrono::steady_clock::time_point time);
+	void setStopSignal(const std::atomic<bool> *signal) { stopSignal = signal; }
+	void setSelectivity(const Selectivity &settings) { selectivity = settings; }
+
+	/**
+	 * Forget the deadline and an earlier abort, so that an interrupted state can search again.
+	 */
+	void clearAbort()
+	{
+		hasDeadline = false;
+		aborted = false;
+	}
+
+	/**
+	 * Search every candidate move of the current player to depth plies, counting the move itself,
+	 * and set x, y and score to the best one. The best move so far is searched first and its score
+	 * bounds the search of the others. The window starts narrow around the score of the last call
+	 * to a depth of the same parity, or of the table, and widens only if the score falls outside it
+	 * (aspiration windows).
+	 * The result is stored in the transposition table, so the next, deeper call searches this move first.
+	 * Return false, leaving x, y and score alone, if the deadline passed before it finished.
+	 */
+	bool bestMove(int depth, int &x, int &y, int &score);
+
+	/**
+	 * Call bestMove at ever greater depths from firstDepth until aborted.
+	 * Helper threads run this to fill the shared transposition table.
+	 */
+	void deepen(int firstDepth);
 
-	int minimax(Player, int depth) const;
-	int alphaBetaAnalysis(Player, int depth) const;
+	/**
+	 * The moves the last bestMove that finished expects from both sides, starting with its own,
+	 * and who plays them.
+	 */
+	std::vector<Square> getPrincipalVariation() const;
+
+	/**
+	 * Totals over every search run on this state so far.
+	 */
+	const Statistics &getStatistics() const { return statistics; }
+
+	/**
+	 * Start the totals again from zero, keeping the principal variation of the last search.
+	 */
+	void resetStatistics()
+	{
+		std::vector<int> principalVariation = std::move(statistics.principalVariation);
+
+		statistics = Statistics();
+		statistics.principalVariation = std::move(principalVariation);
+	}
+
+	int minimax(Player, int depth);
+	int alphaBetaAnalysis(Player, int depth);
 };
 
 class Game
@@ -200,20 +854,192 @@ private:
 
 	Player currentPlayer;
 
+	/**
+	 * How many moves of its own autoMove looks ahead for a win by fours alone,
+	 * and for one by fours and threes, before searching in full;
+	 * and the nodes and megabytes it then gives a proof-number search for one.
+	 */
+	enum
+	{
+		VcfDepth = 12,
+		VctDepth = 4,
+		ProofNodes = 2000,
+		ProofTableSize = 1
+	};
+
 	int aiDepth;
 
+	/**
+	 * If positive, autoMove deepens its search until this many milliseconds have passed
+	 * instead of searching to aiDepth.
+	 */
+	int timeLimit;
+
+	/**
+	 * Depth of the last search autoMove completed.
+	 */
+	int searchDepth;
+
+	/**
+	 * Number of threads autoMove searches with. With more than one, the search is not deterministic.
+	 */
+	int numThreads;
+
+	GameState::Selectivity selectivity;
+
+	/**
+	 * The only randomness in choosing moves, which picks between those of the book. Kept per game
+	 * so that games on different threads neither share it nor disturb each other's.
+	 */
+	std::mt19937 random;
+
+	TranspositionTable transpositionTable;
+
+	/**
+	 * Moves autoMove plays without searching, in the positions it knows.
+	 */
+	OpeningBook book;
+
+	GameState::Statistics searchStatistics;
+
+	std::vector<Square> principalVariation;
+
+	/**
+	 * The move startAutoMove is choosing on another thread, as x + y * Board::SideLen.
+	 */
+	std::future<int> pendingMove;
+
+	/**
+	 * Set to make the search behind pendingMove give up.
+	 */
+	std::atomic<bool> cancelled;
+
+	/**
+	 * Pondering: once autoMove has played, the position after the reply its search expects (or failing that, the table)
+	 * is searched on another thread while the reply is awaited. If the expected reply comes,
+	 * the next search carries on from the depth the ponder search reached; otherwise the ponder
+	 * search is dropped, but what it put in the transposition table stays.
+	 */
+	bool pondering;
+	int expectedReply;
+	uint64_t ponderKey; // of the position after expectedReply
+	std::unique_ptr<GameState> ponderState;
+	std::future<void> ponderSearch;
+	std::atomic<bool> stopPonderSearch;
+
+	/**
+	 * Results of the last depth the ponder search finished.
+	 */
+	int ponderDepth;
+	int ponderBestMove;
+	int ponderScore;
+
 	bool placePiece(int x, int y);
 
+	void startPondering();
+	void ponder(int maxDepth);
+
+	/**
+	 * Stop the ponder search and wait for it, keeping its state for the next search.
+	 */
+	void stopPondering();
+
+	/**
+	 * Choose a move for the current player without playing it.
+	 * Return it as x + y * Board::SideLen, or TranspositionTable::NoMove if cancelled.
+	 */
+	int chooseMove();
+
 public:
-	Game() : currentPlayer(X), aiDepth(4) {}
+	Game() : currentPlayer(X), aiDepth(4), timeLimit(0), searchDepth(0), numThreads(1), selectivity(GameState::DefaultSelectivity), random(std::random_device()()), searchStatistics(), cancelled(false), pondering(false), expectedReply(TranspositionTable::NoMove), ponderKey(0), stopPonderSearch(false), ponderDepth(0), ponderBestMove(TranspositionTable::NoMove), ponderScore(0) {}
+	~Game()
+	{
+		cancelAutoMove();
+		stopPondering();
+	}
 
 	Player getCurrentPlayer() const { return currentPlayer; }
-	bool makeMove(int x, int y) { return placePiece(x, y); }
+	bool makeMove(int x, int y);
 	bool autoMove();
-	inline void undo() { board.undo(); }
+	void undo();
 	void restart();
 
-	void setDepth(int depth) { aiDepth = depth; }
+	/**
+	 * Start choosing a move for the current player on another thread and return at once.
+	 * The settings below must not change until the move has been played or cancelled.
+	 */
+	void startAutoMove();
+
+	/**
+	 * Whether the move started by startAutoMove is still being chosen.
+	 */
+	bool thinking() const { return pendingMove.valid() && pendingMove.wait_for(std::chrono::seconds(0)) != std::future_status::ready; }
+
+	/**
+	 * Play the move started by startAutoMove if it is ready. Return true if a move was played.
+	 */
+	bool pollAutoMove();
+
+	/**
+	 * Abandon the move being chosen, if any, and wait for its search to give up.
+	 * makeMove, undo, restart, setCandidateRadius, setHashSize and loadBook do this first.
+	 */
+	void cancelAutoMove();
+
+	/**
+	 * Whether to search on while waiting for the reply to autoMove.
+	 */
+	void setPondering(bool enabled);
+	bool isPondering() const { return pondering; }
+
+	/**
+	 * Search to a fixed depth from now on.
+	 */
+	void setDepth(int depth)
+	{
+		aiDepth = depth;
+		timeLimit = 0;
+	}
+
+	/**
+	 * Search for a fixed time from now on, as deep as it allows.
+	 */
+	void setTimeLimit(int milliseconds) { timeLimit = milliseconds; }
+	void setThreads(int threads) { numThreads = std::max(threads, 1); }
+
+	/**
+	 * Settings of the reductions, pruning and quiescence search of the searches from now on.
+	 */
+	void setSelectivity(const GameState::Selectivity &settings) { selectivity = settings; }
+	const GameState::Selectivity &getSelectivity() const { return selectivity; }
+
+	/**
+	 * Make the moves chosen from now on depend only on seed and the position, not on when the game began.
+	 */
+	void setSeed(unsigned seed) { random.seed(seed); }
+	void setCandidateRadius(int radius)
+	{
+		cancelAutoMove();
+		stopPondering();
+		ponderState.reset();
+		board.setCandidateRadius(radius);
+	}
+	void setHashSize(size_t megabytes)
+	{
+		cancelAutoMove();
+		stopPondering();
+		transpositionTable.resize(megabytes);
+	}
+
+	/**
+	 * Play from the opening book at path, as built by woo-book, where it has a move.
+	 * Return false, leaving no book, if it cannot be loaded.
+	 */
+	bool loadBook(const char *path)
+	{
+		cancelAutoMove();
+		return book.load(path);
+	}
 
 	/**
 	 * Return 'r' if game is not over and still Running;
@@ -223,7 +1049,19 @@ public:
 	 */
 	char gameStatus() const { return board.gameStatus(); }
 
-	const Square &getLastestMovedSquare() const { return *board.mostRecentlyModifiedSquare; }
+	Square getLastestMovedSquare() const { return board.getMostRecentlyModifiedSquare(); }
+
+	/**
+	 * Statistics of the last search run by autoMove, with the counters summed over its threads.
+	 * The work of a ponder search it carried on from is not counted.
+	 */
+	const GameState::Statistics &getSearchStatistics() const { return searchStatistics; }
+	int getSearchDepth() const { return searchDepth; }
+
+	/**
+	 * The line of play the last search expects, starting with the move autoMove made.
+	 */
+	const std::vector<Square> &getPrincipalVariation() const { return principalVariation; }
 };
 
 #endif
@@ -0,0 +1,264 @@
+#include "game.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+/**
+ * Samples taken of every primitive; each sample runs it for at least MinSampleTime.
+ */
+static const int Samples = 15;
+static const std::chrono::microseconds MinSampleTime(5000);
+
+/**
+ * Defeats the optimiser: every result is added to it.
+ */
+static volatile uint64_t sink;
+
+/**
+ * Makes the optimiser assume the object is read, so that building it cannot be skipped.
+ */
+static void escape(const void *object)
+{
+	asm volatile("" : : "r"(object) : "memory");
+}
+
+/**
+ * Time operation, which calls the primitive opsPerCall times, and print its mean cost per call
+ * and the standard deviation of that over the samples, in nanoseconds.
+ */
+template <class Operation>
+static void measure(const char *primitive, const char *boards, size_t opsPerCall, Operation operation)
+{
+	using Clock = std::chrono::steady_clock;
+	size_t calls = 1;
+	uint64_t sum = 0;
+
+	// Enough calls per sample for the clock not to matter
+	for (;;)
+	{
+		auto start = Clock::now();
+		for (size_t i = 0; i < calls; ++i)
+			sum += operation();
+		if (Clock::now() - start >= MinSampleTime)
+			break;
+		calls *= 2;
+	}
+
+	double mean = 0, squares = 0;
+
+	for (int sample = 0; sample < Samples; ++sample)
+	{
+		auto start = Clock::now();
+		for (size_t i = 0; i < calls; ++i)
+			sum += operation();
+		double nanoseconds = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (calls * opsPerCall);
+
+		mean += nanoseconds;
+		squares += nanoseconds * nanoseconds;
+	}
+
+	mean /= Samples;
+	sink += sum;
+	std::printf("%-36s %-10s %10.2f %10.2f\n", primitive, boards, mean, std::sqrt(std::max(squares / Samples - mean * mean, 0.0)));
+}
+
+/**
+ * Boards with stones scattered at random, up to half the board full, without regard to who has won.
+ */
+static std::vector<Board> randomBoards()
+{
+	std::vector<Board> boards;
+
+	for (int i = 0; i < 8; ++i)
+	{
+		Board board;
+		int stones = 20 + 12 * i;
+
+		while (int(board.numSquareOccupied()) < stones)
+		{
+			int x = std::rand() % Board::SideLen, y = std::rand() % Board::SideLen;
+
+			if (!board.squareOccupied(x, y))
+				board.makeMove(x, y);
+		}
+		boards.push_back(board);
+	}
+
+	return boards;
+}
+
+/**
+ * Middle games: a few random stones near the centre, then moves chosen by a shallow search until either
+ * 12 to 33 stones are down or the game is over.
+ */
+static std::vector<Board> midGameBoards()
+{
+	std::vector<Board> boards;
+	TranspositionTable table(1);
+
+	for (int i = 0; i < 8; ++i)
+	{
+		Board board;
+		int stones = 12 + 3 * i;
+
+		while (board.numSquareOccupied() < 3)
+		{
+			int x = 5 + std::rand() % 5, y = 5 + std::rand() % 5;
+
+			if (!board.squareOccupied(x, y))
+				board.makeMove(x, y);
+		}
+
+		while (int(board.numSquareOccupied()) < stones && board.gameStatus() == 'r')
+		{
+			GameState state(board, &table);
+			int x, y, score;
+
+			state.bestMove(2, x, y, score);
+			board.makeMove(x, y);
+		}
+		boards.push_back(board);
+	}
+
+	return boards;
+}
+
+/**
+ * Microbenchmarks of the primitives of Board, PieceStrip and MoveAnalyser, in nanoseconds per call.
+ *
+ * Usage: woo-microbench
+ */
+int main()
+{
+	std::srand(1);
+
+	std::printf("%-36s %-10s %10s %10s\n", "primitive", "boards", "ns/op", "stddev");
+
+	for (int kind = 0; kind < 2; ++kind)
+	{
+		const char *name = (kind == 0) ? "random" : "mid-game";
+		std::vector<Board> boards = (kind == 0) ? randomBoards() : midGameBoards();
+		std::vector<PieceStrip> strips;
+		size_t squares = boards.size() * Board::NumSquares;
+		size_t empty = 0, candidates = 0;
+
+		for (const Board &board : boards)
+		{
+			empty += Board::NumSquares - board.numSquareOccupied();
+			for (int y = 0; y < Board::SideLen; ++y)
+				candidates += __builtin_popcount(board.getCandidates()[y]);
+			for (int y = 0; y < Board::SideLen; ++y)
+			{
+				for (int x = 0; x < Board::SideLen; ++x)
+				{
+					for (const PieceStrip &strip : board.getSurroundingPieces(x, y))
+						strips.push_back(strip);
+				}
+			}
+		}
+
+		measure("Board::getSurroundingPieces", name, squares, [&]
+				{
+					uint64_t sum = 0;
+					for (const Board &board : boards)
+						for (int y = 0; y < Board::SideLen; ++y)
+							for (int x = 0; x < Board::SideLen; ++x)
+								sum += board.getSurroundingPieces(x, y)[2][x % 9];
+					return sum; });
+
+		measure("Board::getSurroundingStrips", name, squares, [&]
+				{
+					uint64_t sum = 0;
+					for (const Board &board : boards)
+						for (int y = 0; y < Board::SideLen; ++y)
+							for (int x = 0; x < Board::SideLen; ++x)
+								sum += board.getSurroundingStrips(x, y, X)[y % 4];
+					return sum; });
+
+		measure("Board::gameStatus", name, boards.size(), [&]
+				{
+					uint64_t sum = 0;
+					for (const Board &board : boards)
+						sum += board.gameStatus();
+					return sum; });
+
+		measure("Board::hasOccupiedSquaresNearby", name, squares, [&]
+				{
+					uint64_t sum = 0;
+					for (const Board &board : boards)
+						for (int y = 0; y < Board::SideLen; ++y)
+							for (int x = 0; x < Board::SideLen; ++x)
+								sum += board.hasOccupiedSquaresNearby(x, y);
+					return sum; });
+
+		measure("Board::getCurrentPlayer", name, boards.size(), [&]
+				{
+					uint64_t sum = 0;
+					for (const Board &board : boards)
+						sum += board.getCurrentPlayer();
+					return sum; });
+
+		measure("PieceStrip::hasAWinningConnection", name, strips.size(), [&]
+				{
+					uint64_t sum = 0;
+					for (const PieceStrip &strip : strips)
+						sum += strip.hasAWinningConnection();
+					return sum; });
+
+		measure("MoveAnalyser::analysisResult", name, 2 * candidates, [&]
+				{
+					uint64_t sum = 0;
+					for (const Board &board : boards)
+						for (int y = 0; y < Board::SideLen; ++y)
+							for (unsigned row = board.getCandidates()[y]; row != 0; row &= row - 1)
+							{
+								int x = __builtin_ctz(row);
+								sum += MoveAnalyser(board, x, y, X).analysisResult() + MoveAnalyser(board, x, y, O).analysisResult();
+							}
+					return sum; });
+
+		measure("Board::Board(const Board &)", name, boards.size(), [&]
+				{
+					uint64_t sum = 0;
+					for (const Board &board : boards)
+					{
+						Board copy(board);
+						escape(&copy);
+						sum += copy.getKey();
+					}
+					return sum; });
+
+		measure("Board::Board(const Board &, x, y)", name, empty, [&]
+				{
+					uint64_t sum = 0;
+					for (const Board &board : boards)
+						for (int y = 0; y < Board::SideLen; ++y)
+							for (int x = 0; x < Board::SideLen; ++x)
+								if (!board.squareOccupied(x, y))
+								{
+									Board copy(board, x, y);
+									escape(&copy);
+									sum += copy.getKey();
+								}
+					return sum; });
+
+		measure("Board::makeMove + unmakeMove", name, empty, [&]
+				{
+					uint64_t sum = 0;
+					for (Board &board : boards)
+						for (int y = 0; y < Board::SideLen; ++y)
+							for (int x = 0; x < Board::SideLen; ++x)
+								if (!board.squareOccupied(x, y))
+								{
+									board.makeMove(x, y);
+									sum += board.getKey();
+									board.unmakeMove();
+								}
+					return sum; });
+	}
+
+	return 0;
+}
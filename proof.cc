@@ -0,0 +1,191 @@
+#include "proof.h"
+#include "threat.h"
+#include "trace.h"
+#include <algorithm>
+
+ProofSearch::ProofSearch(const Board &b, uint64_t limit, size_t megabytes) : board(ThreatSearch::threatBoard(b)), attacker(b.getCurrentPlayer()), rootMoves(b.numSquareOccupied()), winningMove(TranspositionTable::NoMove), nodes(0), nodeLimit(limit)
+{
+	size_t buckets = 1;
+
+	while (buckets * 2 * 2 * sizeof(Entry) <= megabytes * 1024 * 1024)
+		buckets *= 2;
+
+	table.assign(buckets * 2, Entry{0, 0, 0, 0});
+}
+
+void ProofSearch::lookup(uint64_t key, uint32_t &proof, uint32_t &disproof) const
+{
+	size_t bucket = (key & (table.size() / 2 - 1)) * 2;
+
+	for (size_t i = bucket; i < bucket + 2; ++i)
+	{
+		if (table[i].work != 0 && table[i].key == key)
+		{
+			proof = table[i].proof;
+			disproof = table[i].disproof;
+			return;
+		}
+	}
+
+	proof = 1;
+	disproof = 1;
+}
+
+void ProofSearch::store(uint64_t key, uint32_t proof, uint32_t disproof, uint64_t work)
+{
+	size_t bucket = (key & (table.size() / 2 - 1)) * 2;
+	Entry entry{key, proof, disproof, uint32_t(std::min(work, uint64_t(UINT32_MAX)))};
+
+	if (table[bucket].key == key || table[bucket].work <= entry.work)
+	{
+		// The entry it replaces may still be worth keeping in the other slot
+		if (table[bucket].key != key)
+			table[bucket + 1] = table[bucket];
+		table[bucket] = entry;
+	}
+	else
+		table[bucket + 1] = entry;
+}
+
+int ProofSearch::generateMoves(std::array<int, Board::NumSquares> &moves, uint32_t &proof, uint32_t &disproof) const
+{
+	Player mover = board.getCurrentPlayer();
+	Player other = adversaryOf(mover);
+	int count = 0;
+	int fives = 0, block = TranspositionTable::NoMove;
+
+	for (int y = 0; y < Board::SideLen; ++y)
+	{
+		for (unsigned row = board.getCandidates()[y]; row != 0; row &= row - 1)
+		{
+			int x = __builtin_ctz(row);
+			int square = x + y * Board::SideLen;
+			ThreatSearch::Threat threat = ThreatSearch::analyse(board, x, y, mover);
+
+			// The mover wins at once
+			if (threat.five)
+			{
+				moves[0] = square;
+				proof = (mover == attacker) ? 0 : Infinity;
+				disproof = (mover == attacker) ? Infinity : 0;
+				return 0;
+			}
+
+			if (ThreatSearch::analyse(board, x, y, other).five)
+			{
+				++fives;
+				block = square;
+			}
+
+			// The attacker only makes threats; the defender may play anywhere
+			if (mover != attacker || threat.fours > 0 || threat.numOpenFourSquares > 0)
+				moves[count++] = square;
+		}
+	}
+
+	if (fives == 1)
+	{
+		moves[0] = block;
+		return 1;
+	}
+
+	// Of two fives, the mover can only block one; with nothing to try, the attacker has failed
+	if (fives > 1 || count == 0)
+	{
+		proof = (mover == attacker || count == 0) ? Infinity : 0;
+		disproof = (mover == attacker || count == 0) ? 0 : Infinity;
+		return 0;
+	}
+
+	return count;
+}
+
+void ProofSearch::search(uint32_t proofThreshold, uint32_t disproofThreshold)
+{
+	uint64_t nodesBefore = nodes++;
+	bool attacking = board.getCurrentPlayer() == attacker;
+	std::array<int, Board::NumSquares> moves;
+	uint32_t proof, disproof;
+	int count = generateMoves(moves, proof, disproof);
+
+	if (count == 0 && proof == 0 && board.numSquareOccupied() == rootMoves)
+		winningMove = moves[0];
+
+	while (count > 0)
+	{
+		// At the attacker's nodes, the proof number is the least of the children's
+		// and the disproof number their sum; the other way round at the defender's
+		uint64_t sum = 0;
+		uint32_t least = Infinity, secondLeast = Infinity;
+		uint32_t childProof = 1, childDisproof = 1;
+		int best = 0;
+
+		for (int i = 0; i < count; ++i)
+		{
+			uint32_t p, d;
+			lookup(board.getCanonicalKeyAfter(moves[i] % Board::SideLen, moves[i] / Board::SideLen), p, d);
+
+			uint32_t minimised = attacking ? p : d;
+			sum += attacking ? d : p;
+
+			if (minimised < least)
+			{
+				secondLeast = least;
+				least = minimised;
+				best = i;
+				childProof = p;
+				childDisproof = d;
+			}
+			else if (minimised < secondLeast)
+				secondLeast = minimised;
+		}
+
+		proof = attacking ? least : uint32_t(std::min(sum, uint64_t(Infinity)));
+		disproof = attacking ? uint32_t(std::min(sum, uint64_t(Infinity))) : least;
+
+		if (proof >= proofThreshold || disproof >= disproofThreshold || nodes >= nodeLimit)
+		{
+			if (board.numSquareOccupied() == rootMoves && proof == 0)
+				winningMove = moves[best];
+			break;
+		}
+
+		// The best child is searched until it stops being the best, or this node reaches a threshold
+		uint32_t nextProof, nextDisproof;
+
+		if (attacking)
+		{
+			nextProof = std::min(proofThreshold, secondLeast + 1);
+			nextDisproof = uint32_t(std::min(uint64_t(disproofThreshold) - disproof + childDisproof, uint64_t(Infinity)));
+		}
+		else
+		{
+			nextProof = uint32_t(std::min(uint64_t(proofThreshold) - proof + childProof, uint64_t(Infinity)));
+			nextDisproof = std::min(disproofThreshold, secondLeast + 1);
+		}
+
+		board.makeMove(moves[best] % Board::SideLen, moves[best] / Board::SideLen);
+		search(nextProof, nextDisproof);
+		board.unmakeMove();
+	}
+
+	store(board.getCanonicalKey(), proof, disproof, nodes - nodesBefore);
+}
+
+ProofSearch::Result ProofSearch::solve()
+{
+	TRACE_SPAN("ProofSearch::solve");
+	uint32_t proof, disproof;
+
+	if (board.gameStatus() == 'r')
+		search(Infinity, Infinity);
+
+	lookup(board.getCanonicalKey(), proof, disproof);
+
+	if (proof == 0)
+		return Proven;
+	else if (disproof == 0)
+		return Disproven;
+	else
+		return Unknown;
+}
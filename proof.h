@@ -0,0 +1,93 @@
+#ifndef PROOF_H_
+#define PROOF_H_
+
+#include "game.h"
+
+/**
+ * Depth-first proof-number search (df-pn) of whether the player to move can force a win.
+ * The attacker tries its fours and threes, or the block of a five it must stop;
+ * the defender tries every candidate, or the block of the attacker's five.
+ * A proof is therefore exact, while a disproof means that no win by continuous threats exists.
+ * Proof and disproof numbers are kept by canonical key, shared between rotations and reflections,
+ * in a table of fixed size, so memory stays bounded however long the search runs.
+ */
+class ProofSearch
+{
+public:
+	enum Result
+	{
+		Proven,
+		Disproven,
+		Unknown
+	};
+
+private:
+	/**
+	 * Proof or disproof number of a decided node. Sums saturate at it.
+	 */
+	static const uint32_t Infinity = 100000000;
+
+	struct Entry
+	{
+		uint64_t key;
+		uint32_t proof;
+		uint32_t disproof;
+		uint32_t work; // nodes searched below it, 0 if the slot is empty
+	};
+
+	/**
+	 * Two slots per key: the first keeps whichever entry took more work, the second takes the rest.
+	 */
+	std::vector<Entry> table;
+
+	Board board;
+	Player attacker;
+	size_t rootMoves;
+	int winningMove;
+
+	uint64_t nodes;
+	uint64_t nodeLimit;
+
+	/**
+	 * Set the numbers stored for key, or 1 and 1 if there are none.
+	 */
+	void lookup(uint64_t key, uint32_t &proof, uint32_t &disproof) const;
+	void store(uint64_t key, uint32_t proof, uint32_t disproof, uint64_t work);
+
+	/**
+	 * Put the moves to try at the current node into moves and return how many there are.
+	 * If there are none, the node is decided and proof and disproof are set;
+	 * if the mover decided it by making five, moves[0] is where.
+	 */
+	int generateMoves(std::array<int, Board::NumSquares> &moves, uint32_t &proof, uint32_t &disproof) const;
+
+	/**
+	 * Search the current node until its proof number reaches proofThreshold
+	 * or its disproof number disproofThreshold, or the node limit is reached.
+	 */
+	void search(uint32_t proofThreshold, uint32_t disproofThreshold);
+
+public:
+	ProofSearch(const Board &b, uint64_t limit = 100000, size_t megabytes = 16);
+	~ProofSearch() {}
+
+	/**
+	 * Search until the win of the player to move is proven or disproven, or the node limit is reached.
+	 */
+	Result solve();
+
+	/**
+	 * The move that wins, as x + y * Board::SideLen, after solve returned Proven,
+	 * and TranspositionTable::NoMove otherwise.
+	 */
+	int getWinningMove() const { return winningMove; }
+
+	uint64_t getNodes() const { return nodes; }
+
+	/**
+	 * Bytes taken by the node table.
+	 */
+	size_t getMemoryUse() const { return table.size() * sizeof(Entry); }
+};
+
+#endif
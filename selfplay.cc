@@ -0,0 +1,311 @@
+#include "game.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * How one side plays, set by a string such as "depth=5,quiescence=0".
+ */
+struct Settings
+{
+	int depth = 4;
+	int time = 0; // milliseconds per move, searching to depth if 0
+	int threads = 1;
+	int radius = 2;
+	size_t hash = 16;
+	std::string book; // path of the opening book, none if empty
+	GameState::Selectivity selectivity = GameState::DefaultSelectivity;
+
+	bool parse(const std::string &text)
+	{
+		std::istringstream fields(text);
+		std::string field;
+
+		while (std::getline(fields, field, ','))
+		{
+			size_t equals = field.find('=');
+			if (equals == std::string::npos)
+				return false;
+
+			std::string key = field.substr(0, equals);
+			int value = std::atoi(field.c_str() + equals + 1);
+
+			if (key == "depth")
+				depth = value;
+			else if (key == "time")
+				time = value;
+			else if (key == "threads")
+				threads = value;
+			else if (key == "radius")
+				radius = value;
+			else if (key == "hash")
+				hash = value;
+			else if (key == "book")
+				book = field.substr(equals + 1);
+			else if (key == "lmr")
+				selectivity.reductions = value != 0;
+			else if (key == "futility")
+				selectivity.futility = value != 0;
+			else if (key == "margin")
+				selectivity.futilityMargin = value;
+			else if (key == "quiescence")
+				selectivity.quiescence = value != 0;
+			else
+				return false;
+		}
+
+		return depth > 0 && radius >= 1 && radius <= Board::MaxCandidateRadius;
+	}
+
+	bool apply(Game &game) const
+	{
+		if (!book.empty() && !game.loadBook(book.c_str()))
+			return false;
+		game.setDepth(depth);
+		if (time > 0)
+			game.setTimeLimit(time);
+		game.setThreads(threads);
+		game.setCandidateRadius(radius);
+		game.setHashSize(hash);
+		game.setSelectivity(selectivity);
+		return true;
+	}
+};
+
+/**
+ * Results so far, from the point of view of side A.
+ */
+struct Tally
+{
+	int wins = 0, draws = 0, losses = 0;
+	int errors = 0; // games abandoned because a side made no move, which count as none of the above
+	uint64_t nodes[2] = {0, 0};
+	double seconds[2] = {0, 0};
+
+	int games() const { return wins + draws + losses; }
+	double score() const { return (games() == 0) ? 0.5 : (wins + draws / 2.0) / games(); }
+
+	/**
+	 * Variance of the result of one game.
+	 */
+	double variance() const
+	{
+		if (games() == 0)
+			return 0;
+
+		double s = score();
+		return (wins * (1 - s) * (1 - s) + draws * (0.5 - s) * (0.5 - s) + losses * s * s) / games();
+	}
+};
+
+static double eloOf(double score)
+{
+	score = std::min(std::max(score, 1e-6), 1 - 1e-6);
+	return -400 * std::log10(1 / score - 1);
+}
+
+static double scoreOf(double elo)
+{
+	return 1 / (1 + std::pow(10, -elo / 400));
+}
+
+/**
+ * Log-likelihood ratio of A being elo1 rather than elo0 stronger, by the normal approximation
+ * to the distribution of the results.
+ */
+static double logLikelihoodRatio(const Tally &tally, double elo0, double elo1)
+{
+	double variance = tally.variance();
+
+	if (tally.games() == 0 || variance <= 0)
+		return 0;
+
+	double s0 = scoreOf(elo0), s1 = scoreOf(elo1);
+	return tally.games() * (s1 - s0) * (2 * tally.score() - s0 - s1) / (2 * variance);
+}
+
+/**
+ * Play a game between a and b from a random opening of the given number of moves,
+ * a taking X if aFirst, and add it to the tally. Return 1 if a won, -1 if b won, 0 for a draw
+ * and -2 if the game was abandoned because a side made no move.
+ */
+static int play(const Settings &a, const Settings &b, bool aFirst, int openingMoves, unsigned seed, Tally &tally, std::mutex &tallyLock)
+{
+	Game games[2];
+	uint64_t nodes[2] = {0, 0};
+	double seconds[2] = {0, 0};
+	std::mt19937 random(seed);
+
+	a.apply(games[0]);
+	b.apply(games[1]);
+	games[0].setSeed(seed);
+	games[1].setSeed(seed + 1);
+
+	// The same opening, near the centre, for both games of a pair
+	for (int i = 0; i < openingMoves; ++i)
+	{
+		int x, y;
+
+		do
+		{
+			x = Board::SideLen / 2 - 2 + int(random() % 5);
+			y = Board::SideLen / 2 - 2 + int(random() % 5);
+		} while (!games[0].makeMove(x, y));
+		games[1].makeMove(x, y);
+	}
+
+	while (games[0].gameStatus() == 'r')
+	{
+		int mover = ((games[0].getCurrentPlayer() == X) == aFirst) ? 0 : 1;
+		auto start = std::chrono::steady_clock::now();
+
+		if (!games[mover].autoMove())
+		{
+			std::lock_guard<std::mutex> guard(tallyLock);
+			++tally.errors;
+			std::cerr << "woo-selfplay: " << char('A' + mover) << " made no move; game abandoned" << std::endl;
+			return -2;
+		}
+		seconds[mover] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		nodes[mover] += games[mover].getSearchStatistics().nodes;
+
+		Square move = games[mover].getLastestMovedSquare();
+		games[1 - mover].makeMove(move.getX(), move.getY());
+	}
+
+	char status = games[0].gameStatus();
+	int result = (status == 'x') ? (aFirst ? 1 : -1) : (status == 'o') ? (aFirst ? -1 : 1) : 0;
+
+	std::lock_guard<std::mutex> guard(tallyLock);
+	if (result > 0)
+		++tally.wins;
+	else if (result < 0)
+		++tally.losses;
+	else
+		++tally.draws;
+	for (int side = 0; side < 2; ++side)
+	{
+		tally.nodes[side] += nodes[side];
+		tally.seconds[side] += seconds[side];
+	}
+
+	return result;
+}
+
+/**
+ * Headless tournament between two settings of the engine, A and B, on every core.
+ * Games come in pairs with the same random opening and colours swapped. With -sprt, play stops
+ * once the sequential probability ratio test accepts either that A is elo0 or that it is elo1 stronger.
+ * A game in which a side makes no move is abandoned and reported, and makes the exit status 1.
+ *
+ * Usage: woo-selfplay [-g games] [-j threads] [-a settings] [-b settings] [-o opening moves] [-s seed]
+ *                     [-sprt elo0 elo1 alpha beta]
+ * Settings are comma separated: depth=, time= (ms), threads=, radius= (1 to 7), hash= (MB), book= (file), lmr=, futility=, margin=, quiescence=.
+ */
+int main(int argc, char **argv)
+{
+	int games = 100, threads = std::max(1u, std::thread::hardware_concurrency()), openingMoves = 4;
+	unsigned seed = 1;
+	Settings a, b;
+	bool sprt = false;
+	double elo0 = 0, elo1 = 10, alpha = 0.05, beta = 0.05;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "-g") == 0 && i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+			games = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+			threads = std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "-a") == 0 && i + 1 < argc && a.parse(argv[i + 1]))
+			++i;
+		else if (std::strcmp(argv[i], "-b") == 0 && i + 1 < argc && b.parse(argv[i + 1]))
+			++i;
+		else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			openingMoves = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seed = std::strtoul(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "-sprt") == 0 && i + 4 < argc)
+		{
+			sprt = true;
+			elo0 = std::atof(argv[++i]);
+			elo1 = std::atof(argv[++i]);
+			alpha = std::atof(argv[++i]);
+			beta = std::atof(argv[++i]);
+		}
+		else
+		{
+			std::cerr << "usage: woo-selfplay [-g games] [-j threads] [-a settings] [-b settings] [-o opening moves] [-s seed] [-sprt elo0 elo1 alpha beta]" << std::endl;
+			return 2;
+		}
+	}
+
+	// Check the books can be loaded before any game starts
+	Game check;
+	if (!a.apply(check) || !b.apply(check))
+	{
+		std::cerr << "woo-selfplay: cannot load the opening book" << std::endl;
+		return 2;
+	}
+
+	double lowerBound = std::log(beta / (1 - alpha)), upperBound = std::log((1 - beta) / alpha);
+	Tally tally;
+	std::mutex tallyLock;
+	std::atomic<int> nextGame(0);
+	std::atomic<bool> decided(false);
+	std::vector<std::thread> workers;
+	auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < threads; ++i)
+	{
+		workers.emplace_back([&]
+							 {
+								 for (int game = nextGame++; game < games && !decided; game = nextGame++)
+								 {
+									 play(a, b, game % 2 == 0, openingMoves, seed + unsigned(game / 2) * 7919, tally, tallyLock);
+
+									 std::lock_guard<std::mutex> guard(tallyLock);
+									 double llr = logLikelihoodRatio(tally, elo0, elo1);
+									 if (sprt && (llr <= lowerBound || llr >= upperBound))
+										 decided = true;
+								 } });
+	}
+
+	for (auto &worker : workers)
+		worker.join();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double score = tally.score();
+	double margin = (tally.games() == 0) ? 0 : 1.96 * std::sqrt(tally.variance() / tally.games());
+
+	std::printf("games: %d\n", tally.games());
+	std::printf("A wins: %d  draws: %d  losses: %d\n", tally.wins, tally.draws, tally.losses);
+	if (tally.errors > 0)
+		std::printf("abandoned: %d\n", tally.errors);
+	if (tally.games() > 0)
+	{
+		std::printf("score: %.3f\n", score);
+		std::printf("elo: %.1f  (95%%: %.1f to %.1f)\n", eloOf(score), eloOf(score - margin), eloOf(score + margin));
+	}
+	if (sprt)
+	{
+		double llr = logLikelihoodRatio(tally, elo0, elo1);
+
+		std::printf("sprt: llr %.3f  bounds %.3f to %.3f  %s\n", llr, lowerBound, upperBound, (llr >= upperBound) ? "H1 accepted" : (llr <= lowerBound) ? "H0 accepted" : "undecided");
+	}
+	for (int side = 0; side < 2; ++side)
+		std::printf("%c nodes per second: %.0f\n", 'A' + side, tally.nodes[side] / std::max(tally.seconds[side], 1e-9));
+	std::printf("nodes per second: %.0f\n", (tally.nodes[0] + tally.nodes[1]) / std::max(tally.seconds[0] + tally.seconds[1], 1e-9));
+	std::printf("time: %.1f s\n", seconds);
+
+	return (tally.errors > 0) ? 1 : 0;
+}
@@ -0,0 +1,70 @@
+#include "proof.h"
+#include "trace.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+/**
+ * Headless analysis: play the given moves, then ask whether the player to move can force a win.
+ *
+ * Usage: woo-solve [-n nodes] [-m megabytes] [x,y ...]
+ * Moves are read from standard input if none are given.
+ */
+int main(int argc, char **argv)
+{
+	uint64_t nodeLimit = 1000000;
+	size_t megabytes = 64;
+	Board board;
+	bool movesGiven = false;
+
+	auto play = [&board](const std::string &move)
+	{
+		int x, y;
+
+		if (std::sscanf(move.c_str(), "%d,%d", &x, &y) != 2 || !board.coordValid(x, y) || board.squareOccupied(x, y) || board.gameStatus() != 'r')
+		{
+			std::cerr << "woo-solve: cannot play " << move << std::endl;
+			std::exit(2);
+		}
+		board.makeMove(x, y);
+	};
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			nodeLimit = std::strtoull(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+			megabytes = std::strtoul(argv[++i], nullptr, 10);
+		else
+		{
+			play(argv[i]);
+			movesGiven = true;
+		}
+	}
+
+	if (!movesGiven)
+	{
+		std::string move;
+		while (std::cin >> move)
+			play(move);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	ProofSearch search(board, nodeLimit, megabytes);
+	ProofSearch::Result result = search.solve();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	Trace::flush();
+
+	std::cout << "to move: " << ((board.getCurrentPlayer() == X) ? 'x' : 'o') << std::endl;
+	std::cout << "result: " << ((result == ProofSearch::Proven) ? "proven" : (result == ProofSearch::Disproven) ? "disproven" : "unknown") << std::endl;
+	if (result == ProofSearch::Proven)
+		std::cout << "move: " << search.getWinningMove() % Board::SideLen << ',' << search.getWinningMove() / Board::SideLen << std::endl;
+	std::cout << "nodes: " << search.getNodes() << std::endl;
+	std::cout << "memory: " << search.getMemoryUse() << " bytes" << std::endl;
+	std::cout << "time: " << seconds << " s" << std::endl;
+
+	return (result == ProofSearch::Unknown) ? 1 : 0;
+}
@@ -0,0 +1,337 @@
+#include "threat.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstdlib>
+
+/**
+ * Whether mine holds five in a row through the centre of a nine-square strip.
+ */
+static bool fiveThroughCentre(unsigned mine)
+{
+	return (mine & (mine >> 1) & (mine >> 2) & (mine >> 3) & (mine >> 4) & 0x1F) != 0;
+}
+
+/**
+ * The empty squares of a strip that would complete five through its centre.
+ */
+static unsigned fiveSquares(unsigned mine, unsigned empty)
+{
+	unsigned squares = 0;
+
+	for (unsigned bits = empty; bits != 0; bits &= bits - 1)
+	{
+		unsigned square = bits & -bits;
+
+		if (fiveThroughCentre(mine | square))
+			squares |= square;
+	}
+
+	return squares;
+}
+
+/**
+ * Whether two squares lie on a common line within four squares of each other,
+ * i.e. whether one can change what a move on the other makes.
+ */
+static bool inWindow(int a, int b)
+{
+	int dx = std::abs(a % Board::SideLen - b % Board::SideLen);
+	int dy = std::abs(a / Board::SideLen - b / Board::SideLen);
+
+	return (dx == 0 || dy == 0 || dx == dy) && std::max(dx, dy) <= 4;
+}
+
+const std::vector<uint32_t> ThreatSearch::StripThreats = []
+{
+	std::vector<uint32_t> threats(1 << 18);
+
+	for (unsigned code = 0; code < threats.size(); ++code)
+	{
+		unsigned taken = code >> 9;
+		unsigned blocked = code & 0x1FF;
+
+		// The centre is off the board or the adversary's
+		if ((blocked >> 4) & 1)
+			continue;
+
+		unsigned mine = (taken & ~blocked) | 0x10;
+		unsigned empty = ~(taken | blocked) & 0x1FF & ~0x10u;
+
+		if (fiveThroughCentre(mine))
+		{
+			threats[code] = 1 << 18;
+			continue;
+		}
+
+		threats[code] = fiveSquares(mine, empty);
+
+		for (unsigned bits = empty; bits != 0; bits &= bits - 1)
+		{
+			unsigned square = bits & -bits;
+
+			if (__builtin_popcount(fiveSquares(mine | square, empty & ~square)) >= 2)
+				threats[code] |= square << 9;
+		}
+	}
+
+	return threats;
+}();
+
+ThreatSearch::ThreatSearch(const Board &b, size_t limit) : board(threatBoard(b)), nodes(0), nodeLimit(limit), nodesAllowed(0), threes(false), failures(1 << 14), rootMoves(b.numSquareOccupied()), winningMove(TranspositionTable::NoMove) {}
+
+Board ThreatSearch::threatBoard(const Board &b)
+{
+	Board board(b);
+
+	// Every square a threat can be made on lies within two of a piece
+	if (board.getCandidateRadius() < 2)
+		board.setCandidateRadius(2);
+
+	return board;
+}
+
+ThreatSearch::Threat ThreatSearch::analyse(const Board &board, int x, int y, Player player)
+{
+	Threat threat;
+	auto strips = board.getSurroundingStrips(x, y, player);
+
+	threat.five = false;
+	threat.fours = 0;
+	threat.fourSquare = TranspositionTable::NoMove;
+	threat.numOpenFourSquares = 0;
+
+	for (size_t direction = 0; direction < 4; ++direction)
+	{
+		uint32_t made = StripThreats[strips[direction] | (1 << 13)];
+
+		if ((made >> 18) & 1)
+			threat.five = true;
+
+		// Bit 4 + distance of a strip lies distance squares along the direction
+		for (unsigned bits = made & 0x1FF; bits != 0; bits &= bits - 1)
+		{
+			int distance = __builtin_ctz(bits) - 4;
+			int square = x + Board::Directions[direction][0] * distance + (y + Board::Directions[direction][1] * distance) * Board::SideLen;
+
+			if (threat.fours == 0)
+			{
+				threat.fours = 1;
+				threat.fourSquare = square;
+			}
+			else if (square != threat.fourSquare)
+				threat.fours = 2;
+		}
+
+		for (unsigned bits = (made >> 9) & 0x1FF; bits != 0; bits &= bits - 1)
+		{
+			int distance = __builtin_ctz(bits) - 4;
+			threat.openFourSquares[threat.numOpenFourSquares++] = x + Board::Directions[direction][0] * distance + (y + Board::Directions[direction][1] * distance) * Board::SideLen;
+		}
+	}
+
+	return threat;
+}
+
+int ThreatSearch::findWin(int depth, bool withThrees)
+{
+	TRACE_SPAN("ThreatSearch::findWin", depth);
+	threes = withThrees;
+	nodesAllowed = nodes + nodeLimit;
+	winningMove = TranspositionTable::NoMove;
+	std::fill(failures.begin(), failures.end(), Failure{0, 0});
+
+	if (board.gameStatus() != 'r' || !attack(depth))
+		return TranspositionTable::NoMove;
+
+	return winningMove;
+}
+
+bool ThreatSearch::attack(int depth)
+{
+	if (nodes >= nodesAllowed)
+		return false;
+	++nodes;
+
+	// A failure holds for every rotation and reflection of the position
+	uint64_t key = board.getCanonicalKey();
+	Failure &failure = failures[key & (failures.size() - 1)];
+	if (failure.key == key && failure.depth >= depth)
+		return false;
+
+	bool won = searchThreats(depth);
+
+	if (!won && nodes < nodesAllowed)
+		failure = Failure{key, depth};
+
+	return won;
+}
+
+bool ThreatSearch::searchThreats(int depth)
+{
+	Player attacker = board.getCurrentPlayer();
+	Player defender = adversaryOf(attacker);
+	bool root = board.numSquareOccupied() == rootMoves;
+
+	std::array<int, Board::NumSquares> wins, fours, threats;
+	size_t numWins = 0, numFours = 0, numThreats = 0;
+	int block = TranspositionTable::NoMove;
+	int defenderFives = 0;
+
+	for (int y = 0; y < Board::SideLen; ++y)
+	{
+		for (unsigned row = board.getCandidates()[y]; row != 0; row &= row - 1)
+		{
+			int x = __builtin_ctz(row);
+			int square = x + y * Board::SideLen;
+			Threat threat = analyse(board, x, y, attacker);
+
+			if (threat.five)
+			{
+				if (root)
+					winningMove = square;
+				return true;
+			}
+
+			if (analyse(board, x, y, defender).five)
+			{
+				++defenderFives;
+				block = square;
+			}
+
+			if (threat.fours >= 2)
+				wins[numWins++] = square;
+			else if (threat.fours == 1)
+				fours[numFours++] = square;
+			else if (threat.numOpenFourSquares > 0)
+				threats[numThreats++] = square;
+		}
+	}
+
+	// Of two fives the defender threatens, only one can be blocked
+	if (defenderFives > 1 || depth < 2)
+		return false;
+
+	// An open four or two fours at once win, unless they fail to stop a five of the defender's
+	for (size_t i = 0; i < numWins; ++i)
+	{
+		if (defenderFives == 0 || wins[i] == block)
+		{
+			if (root)
+				winningMove = wins[i];
+			return true;
+		}
+	}
+
+	// A four leaves the defender a single square to play
+	for (size_t i = 0; i < numFours; ++i)
+	{
+		if (defenderFives == 1 && fours[i] != block)
+			continue;
+
+		int x = fours[i] % Board::SideLen, y = fours[i] / Board::SideLen;
+		int reply = analyse(board, x, y, attacker).fourSquare;
+
+		board.makeMove(x, y);
+		board.makeMove(reply % Board::SideLen, reply / Board::SideLen);
+		bool won = attack(depth - 1);
+		board.unmakeMove();
+		board.unmakeMove();
+
+		if (won)
+		{
+			if (root)
+				winningMove = fours[i];
+			return true;
+		}
+	}
+
+	// An open three takes two more moves to win with
+	if (!threes || depth < 3)
+		return false;
+
+	for (size_t i = 0; i < numThreats; ++i)
+	{
+		if (defenderFives == 1 && threats[i] != block)
+			continue;
+
+		int x = threats[i] % Board::SideLen, y = threats[i] / Board::SideLen;
+		Threat three = analyse(board, x, y, attacker);
+
+		board.makeMove(x, y);
+		bool won = defend(three, depth - 1);
+		board.unmakeMove();
+
+		if (won)
+		{
+			if (root)
+				winningMove = threats[i];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool ThreatSearch::stopsThree(const Threat &three, int x, int y)
+{
+	int square = x + y * Board::SideLen;
+	Player attacker = adversaryOf(board.getCurrentPlayer());
+
+	// Only a move on a line with every open four square can stop them all
+	for (int i = 0; i < three.numOpenFourSquares; ++i)
+	{
+		if (three.openFourSquares[i] != square && !inWindow(three.openFourSquares[i], square))
+			return false;
+	}
+
+	bool stopped = true;
+	board.makeMove(x, y);
+
+	for (int i = 0; i < three.numOpenFourSquares && stopped; ++i)
+	{
+		int openFour = three.openFourSquares[i];
+
+		if (openFour != square)
+		{
+			Threat threat = analyse(board, openFour % Board::SideLen, openFour / Board::SideLen, attacker);
+			stopped = !threat.five && threat.fours < 2;
+		}
+	}
+
+	board.unmakeMove();
+	return stopped;
+}
+
+bool ThreatSearch::defend(const Threat &three, int depth)
+{
+	if (nodes >= nodesAllowed)
+		return false;
+	++nodes;
+
+	Player defender = board.getCurrentPlayer();
+
+	// The defender may block the three or make a four of its own
+	for (int y = 0; y < Board::SideLen; ++y)
+	{
+		for (unsigned row = board.getCandidates()[y]; row != 0; row &= row - 1)
+		{
+			int x = __builtin_ctz(row);
+			bool defence = analyse(board, x, y, defender).fours > 0;
+
+			if (!defence)
+				defence = stopsThree(three, x, y);
+
+			if (defence)
+			{
+				board.makeMove(x, y);
+				bool won = attack(depth);
+				board.unmakeMove();
+
+				if (!won)
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
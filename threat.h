@@ -0,0 +1,115 @@
+#ifndef THREAT_H_
+#define THREAT_H_
+
+#include "game.h"
+
+/**
+ * Threat-space search for forced wins. Only the attacker's threats are tried:
+ * fours, which leave the defender a single square to block, and, if asked for, open threes,
+ * which leave the defender the squares that stop every open four and its own fours.
+ * A win by fours alone (VCF) is proven; a win through threes (VCT) assumes any other defence
+ * loses to the open four it allows.
+ */
+class ThreatSearch
+{
+public:
+	/**
+	 * What a move makes along all four lines.
+	 */
+	struct Threat
+	{
+		bool five;
+		int fours;       // distinct squares that would then complete five, counting to 2 at most
+		int fourSquare;  // one of them
+		int openFourSquares[4 * 9];
+		int numOpenFourSquares;
+	};
+
+	/**
+	 * What player would make by playing at the unoccupied square (x, y) of the board.
+	 */
+	static Threat analyse(const Board &, int x, int y, Player);
+
+private:
+	/**
+	 * What a move makes along one line, indexed like MoveAnalyser::StripScores
+	 * with the centre square taken as the mover's:
+	 * bits 0-8 are the squares that would then complete five through it,
+	 * bits 9-17 the squares that would then make an open four through it,
+	 * and bit 18 is set if it makes five already.
+	 */
+	static const std::vector<uint32_t> StripThreats;
+
+	Board board;
+
+	size_t nodes;
+
+	/**
+	 * Nodes each findWin may visit, and the count at which the current one gives up.
+	 */
+	size_t nodeLimit;
+	size_t nodesAllowed;
+
+	bool threes;
+
+	/**
+	 * Positions from which attack found no win in the current findWin, and within how many moves,
+	 * one per slot indexed by key. A search that ran out of nodes proves nothing and is not recorded.
+	 */
+	struct Failure
+	{
+		uint64_t key;
+		int depth;
+	};
+
+	std::vector<Failure> failures;
+
+	/**
+	 * Number of moves on the board at the root, and the first move of the win found from there.
+	 */
+	size_t rootMoves;
+	int winningMove;
+
+	/**
+	 * Whether the player to move wins with at most depth moves of its own.
+	 * attack looks up and records failures; searchThreats does the work.
+	 */
+	bool attack(int depth);
+	bool searchThreats(int depth);
+
+	/**
+	 * Whether the attacker, having just made the open three, still wins after every defence
+	 * with at most depth moves of its own.
+	 */
+	bool defend(const Threat &three, int depth);
+
+	/**
+	 * Whether the defender's move at (x, y) leaves the attacker no open four to make after the three.
+	 */
+	bool stopsThree(const Threat &three, int x, int y);
+
+public:
+	ThreatSearch(const Board &b, size_t limit = 20000);
+	~ThreatSearch() {}
+
+	/**
+	 * Look for a win of the player to move within depth of its moves, by fours only or,
+	 * if withThrees, by fours and open threes.
+	 * Return its first move as x + y * Board::SideLen, or TranspositionTable::NoMove
+	 * if there is none or the node limit ran out first.
+	 */
+	int findWin(int depth, bool withThrees);
+
+	/**
+	 * Nodes visited by every findWin so far.
+	 */
+	size_t getNodes() const { return nodes; }
+
+	/**
+	 * A copy of the board whose candidates take in every square a threat can be made on,
+	 * for the searches that move only among them.
+	 */
+	static Board threatBoard(const Board &);
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include "trace.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	/**
+	 * Spans each thread's buffer keeps.
+	 */
+	const size_t Capacity = 1 << 15;
+
+	struct Event
+	{
+		const char *name;
+		int value;
+		unsigned thread;
+		int64_t start;
+		int64_t end;
+	};
+
+	/**
+	 * A ring of events. A thread takes a buffer when it first records a span and gives it back when
+	 * it exits, so that the next thread to start carries on in it instead of taking another.
+	 */
+	struct Buffer
+	{
+		std::mutex lock;
+		std::vector<Event> events;
+		size_t next;
+		bool full;
+		bool inUse;
+
+		Buffer() : events(Capacity), next(0), full(false), inUse(true) {}
+	};
+
+	std::mutex buffersLock;
+	std::vector<std::unique_ptr<Buffer>> buffers;
+	std::atomic<unsigned> numThreads(0);
+
+	const std::chrono::steady_clock::time_point traceStart = std::chrono::steady_clock::now();
+
+	struct ThreadBuffer
+	{
+		Buffer *buffer;
+		unsigned thread;
+
+		ThreadBuffer() : buffer(nullptr), thread(++numThreads) {}
+		~ThreadBuffer()
+		{
+			if (buffer)
+			{
+				std::lock_guard<std::mutex> guard(buffersLock);
+				buffer->inUse = false;
+			}
+		}
+	};
+
+	thread_local ThreadBuffer threadBuffer;
+
+	Buffer *takeBuffer()
+	{
+		std::lock_guard<std::mutex> guard(buffersLock);
+
+		for (auto &buffer : buffers)
+		{
+			if (!buffer->inUse)
+			{
+				buffer->inUse = true;
+				return buffer.get();
+			}
+		}
+
+		buffers.emplace_back(new Buffer);
+		return buffers.back().get();
+	}
+}
+
+const bool Trace::enabled = std::getenv("WOO_TRACE") != nullptr;
+
+int64_t Trace::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceStart).count();
+}
+
+void Trace::record(const char *name, int value, int64_t start, int64_t end)
+{
+	if (!threadBuffer.buffer)
+		threadBuffer.buffer = takeBuffer();
+
+	Buffer &buffer = *threadBuffer.buffer;
+	std::lock_guard<std::mutex> guard(buffer.lock);
+
+	buffer.events[buffer.next] = Event{name, value, threadBuffer.thread, start, end};
+	if (++buffer.next == Capacity)
+	{
+		buffer.next = 0;
+		buffer.full = true;
+	}
+}
+
+bool Trace::flush()
+{
+	if (!enabled)
+		return false;
+
+	std::FILE *file = std::fopen(std::getenv("WOO_TRACE"), "w");
+	if (!file)
+		return false;
+
+	std::lock_guard<std::mutex> guard(buffersLock);
+	bool first = true;
+
+	std::fprintf(file, "{\"traceEvents\": [\n");
+
+	for (auto &buffer : buffers)
+	{
+		std::lock_guard<std::mutex> bufferGuard(buffer->lock);
+
+		// Oldest first
+		size_t count = buffer->full ? Capacity : buffer->next;
+		size_t oldest = buffer->full ? buffer->next : 0;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			const Event &event = buffer->events[(oldest + i) % Capacity];
+
+			std::fprintf(file, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f", first ? "" : ",\n", event.name, event.thread, event.start / 1000.0, (event.end - event.start) / 1000.0);
+			if (event.value != NoValue)
+				std::fprintf(file, ", \"args\": {\"value\": %d}", event.value);
+			std::fprintf(file, "}");
+			first = false;
+		}
+	}
+
+	std::fprintf(file, "\n], \"displayTimeUnit\": \"ns\"}\n");
+	return std::fclose(file) == 0;
+}
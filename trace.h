@@ -0,0 +1,73 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <cstdint>
+
+/**
+ * Set to 0 to compile the tracing spans out altogether.
+ */
+#ifndef WOO_TRACING
+#define WOO_TRACING 1
+#endif
+
+/**
+ * Timeline of scoped spans, for Chrome's about://tracing or Perfetto.
+ * Tracing is on if the environment variable WOO_TRACE names the file to write to; otherwise
+ * a span costs one test of a flag. Each thread records into a ring buffer of its own,
+ * which keeps the most recent spans once it is full, and flush writes them all out.
+ * Spans mark coarse work, such as searches, iterations and root moves, never single nodes,
+ * so that a buffer holds whole searches.
+ */
+class Trace
+{
+public:
+	enum
+	{
+		NoValue = -1
+	};
+
+	/**
+	 * Records the time from its construction to its destruction under name,
+	 * which must outlive the trace: a string literal. A value other than NoValue is shown with it.
+	 */
+	class Span
+	{
+	private:
+		const char *name;
+		int value;
+		int64_t start; // nanoseconds since the trace began, negative if not tracing
+
+	public:
+		explicit Span(const char *spanName, int spanValue = NoValue) : name(spanName), value(spanValue), start(enabled ? now() : -1) {}
+		~Span()
+		{
+			if (start >= 0)
+				record(name, value, start, now());
+		}
+
+		Span(const Span &) = delete;
+		Span &operator=(const Span &) = delete;
+	};
+
+	static bool isEnabled() { return enabled; }
+
+	/**
+	 * Write every span the buffers hold to the file named by WOO_TRACE, as JSON.
+	 * Return false if tracing is off or the file cannot be written.
+	 */
+	static bool flush();
+
+private:
+	static const bool enabled;
+
+	static int64_t now();
+	static void record(const char *name, int value, int64_t start, int64_t end);
+};
+
+#if WOO_TRACING
+#define TRACE_SPAN(...) Trace::Span traceSpan(__VA_ARGS__)
+#else
+#define TRACE_SPAN(...)
+#endif
+
+#endif
@@ -1,4 +1,5 @@
 #include "ui.h"
+#include "trace.h"
 
 const unsigned int ConsoleHeight = 1.5f * PixelsPerUnit;
 const X1 XSprite::x1;
@@ -85,6 +86,9 @@ void Status::updateStatus(char gameStatus)
 	case 'r':
 		setString("Status: running. Press 'Z' to undo, 'R' to restart.");
 		break;
+	case 't':
+		setString("Status: thinking... Press 'Z' to undo, 'R' to restart.");
+		break;
 	default:
 		break;
 	}
@@ -134,10 +138,19 @@ bool Woo::placePiece(sf::Vector2i position)
 
 void Woo::autoPlace()
 {
-	if(!game.autoMove())
-		abort();
+	if (!game.thinking())
+	{
+		game.startAutoMove();
+		status.updateStatus('t');
+	}
+}
+
+void Woo::collectAutoPlaced()
+{
+	if (!game.pollAutoMove())
+		return;
 
-	auto &theMove = game.getLastestMovedSquare();
+	auto theMove = game.getLastestMovedSquare();
 
 	if (theMove.getPlayer() == X)
 		XPieces.push_back(XSprite(theMove.getX(), theMove.getY()));
@@ -167,6 +180,7 @@ void Woo::restart()
 {
 	game.restart();
 	gameOver = false;
+	status.updateStatus(game.gameStatus());
 
 	XPieces.clear();
 	OPieces.clear();
@@ -174,6 +188,7 @@ void Woo::restart()
 
 void Woo::processEvents()
 {
+	TRACE_SPAN("Woo::processEvents");
 	sf::Event event;
 
 	while (window.pollEvent(event))
@@ -181,10 +196,11 @@ void Woo::processEvents()
 		switch (event.type)
 		{
 		case sf::Event::Closed:
+			game.cancelAutoMove();
 			window.close();
 			break;
 		case sf::Event::MouseButtonPressed:
-			if (!gameOver)
+			if (!gameOver && !game.thinking())
 			{
 				if (sf::Mouse::isButtonPressed(sf::Mouse::Button::Left))
 				{
@@ -193,7 +209,22 @@ void Woo::processEvents()
 			}
 			break;
 		case sf::Event::KeyPressed:
-			if (!gameOver)
+			if (!gameOver && game.thinking())
+			{
+				// Settings stay as they are until the move is made
+				switch (event.key.code)
+				{
+				case sf::Keyboard::Z:
+					undo();
+					break;
+				case sf::Keyboard::R:
+					restart();
+					break;
+				default:
+					break;
+				}
+			}
+			else if (!gameOver)
 			{
 				switch (event.key.code)
 				{
@@ -206,6 +237,15 @@ void Woo::processEvents()
 				case sf::Keyboard::A:
 					autoPlace();
 					break;
+				case sf::Keyboard::P:
+					game.setPondering(!game.isPondering());
+					break;
+				case sf::Keyboard::T:
+					Trace::flush();
+					break;
+				case sf::Keyboard::Num0:
+					game.setTimeLimit(1000);
+					break;
 				case sf::Keyboard::Num1:
 					game.setDepth(1);
 					break;
@@ -252,6 +292,7 @@ void Woo::processEvents()
 
 void Woo::render()
 {
+	TRACE_SPAN("Woo::render");
 	drawLines();
 
 	window.draw(status);
@@ -271,7 +312,9 @@ void Woo::run()
 {
 	while (window.isOpen())
 	{
+		TRACE_SPAN("frame");
 		processEvents();
+		collectAutoPlaced();
 
 		window.clear(sf::Color(240, 220, 130));
 
@@ -279,4 +322,6 @@ void Woo::run()
 
 		window.display();
 	}
+
+	Trace::flush();
 }
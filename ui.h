@@ -4,6 +4,7 @@
 #include "game.h"
 #include <cstdlib>
 #include <ctime>
+#include <thread>
 #include <SFML/Graphics.hpp>
 #include <SFML/Window.hpp>
 
@@ -133,6 +134,11 @@ private:
 
 	bool placePiece(sf::Vector2i position);
 	void autoPlace();
+
+	/**
+	 * Show the move started by autoPlace once the game has played it.
+	 */
+	void collectAutoPlaced();
 	void undo();
 	void restart();
 
@@ -141,7 +147,13 @@ private:
 	void render();
 
 public:
-	Woo() : gameOver(false), window(sf::VideoMode(Board::SideLen * PixelsPerUnit, Board::SideLen * PixelsPerUnit + ConsoleHeight), "Woo", sf::Style::Close | sf::Style::Titlebar) { srand(time(nullptr)); }
+	Woo() : gameOver(false), window(sf::VideoMode(Board::SideLen * PixelsPerUnit, Board::SideLen * PixelsPerUnit + ConsoleHeight), "Woo", sf::Style::Close | sf::Style::Titlebar)
+	{
+		srand(time(nullptr));
+		game.setThreads(std::thread::hardware_concurrency());
+		game.loadBook("/usr/share/woo/woo.book"); // without it, the opening is searched
+		window.setFramerateLimit(60); // leave the CPU to the search
+	}
 	~Woo() {}
 
 	void run();